@@ -8,15 +8,11 @@ void MyAudioCallback(void* buffer, unsigned int frames) {
     for (unsigned int i = 0; i < frames; i++) {
         if (state.playing && state.valid) {
             int v = state.engine.Eval(state.t);
-            
+            state.capture.Capture(state.t, (uint8_t)(v & 0xFF));
+
             float sample = ((v & 0xFF) / 127.5f - 1.0f);
             out[i] = (short)(sample * 32767.0f * state.volume);
 
-            if (i % 8 == 0) {
-                state.scope[state.scopeIdx] = sample;
-                state.scopeIdx = (state.scopeIdx + 1) % 256;
-            }
-
             state.tAccum += tInc;
             if (state.tAccum >= 1.0) {
                 uint32_t steps = (uint32_t)state.tAccum;
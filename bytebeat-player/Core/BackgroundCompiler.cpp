@@ -0,0 +1,106 @@
+﻿#include "BackgroundCompiler.h"
+
+using namespace std;
+
+void BackgroundCompiler::Stop() {
+    {
+        lock_guard<mutex> lock(m_mutex);
+        m_running = false;
+        m_requested = false;
+    }
+    m_wake.notify_all();
+    if (m_thread.joinable()) m_thread.join();
+}
+
+void BackgroundCompiler::Request(const string& code) {
+    {
+        lock_guard<mutex> lock(m_mutex);
+        m_generation++;
+        m_code = code;
+        m_requested = true;
+        m_due = chrono::steady_clock::now() + chrono::milliseconds(DEBOUNCE_MS);
+        m_ready = false;
+
+        // Started on first use rather than in the constructor, the owner is a global
+        if (!m_running) {
+            m_running = true;
+            m_thread = thread(&BackgroundCompiler::Run, this);
+        }
+    }
+    m_wake.notify_all();
+}
+
+void BackgroundCompiler::Cancel() {
+    lock_guard<mutex> lock(m_mutex);
+    m_generation++;
+    m_requested = false;
+    m_ready = false;
+}
+
+bool BackgroundCompiler::Pending() {
+    lock_guard<mutex> lock(m_mutex);
+    return m_requested || m_compiling;
+}
+
+bool BackgroundCompiler::Collect(CompileResult& out) {
+    lock_guard<mutex> lock(m_mutex);
+    if (!m_ready) return false;
+    m_ready = false;
+    out = move(m_result);
+    return true;
+}
+
+void BackgroundCompiler::Recycle(unique_ptr<ComplexEngine> engine) {
+    m_cache.Put(move(engine));
+}
+
+void BackgroundCompiler::CompileNow(const string& code, CompileResult& out) {
+    Cancel();
+    out = CompileResult();
+    out.code = code;
+    out.engine = m_cache.Take(code);
+    if (out.engine) {
+        out.valid = true;
+        return;
+    }
+    out.engine = make_unique<ComplexEngine>();
+    out.valid = out.engine->Compile(code, out.error, out.errorPos);
+}
+
+void BackgroundCompiler::Run() {
+    unique_lock<mutex> lock(m_mutex);
+    while (m_running) {
+        if (!m_requested) {
+            m_wake.wait(lock);
+            continue;
+        }
+        // Each keystroke pushes the deadline back
+        if (chrono::steady_clock::now() < m_due) {
+            m_wake.wait_until(lock, m_due);
+            continue;
+        }
+
+        uint64_t generation = m_generation;
+        CompileResult result;
+        result.code = move(m_code);
+        m_requested = false;
+        m_compiling = true;
+        lock.unlock();
+
+        result.engine = m_cache.Take(result.code);
+        if (result.engine) result.valid = true;
+        else {
+            result.engine = m_cache.TakeNewest();
+            if (!result.engine) result.engine = make_unique<ComplexEngine>();
+            result.valid = result.engine->Recompile(result.code, result.error, result.errorPos);
+        }
+
+        lock.lock();
+        m_compiling = false;
+        if (generation == m_generation) {
+            m_result = move(result);
+            m_ready = true;
+        }
+        else m_cache.Put(move(result.engine));
+    }
+}
@@ -0,0 +1,63 @@
+﻿#pragma once
+#include "Bytebeat.h"
+#include "ProgramCache.h"
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+struct CompileResult {
+    std::string code;
+    bool valid = false;
+    std::string error;
+    int errorPos = -1;
+    std::unique_ptr<ComplexEngine> engine; // Swap into the live engine when valid, then Recycle
+};
+
+// Compiles editor text on a worker once typing pauses, so neither the UI frame nor the audio
+// callback waits on the tokenizer. Only the newest request matters: a request replaces one that
+// hasn't started yet, and a result is dropped if a newer request (or Cancel) arrived meanwhile.
+// Programs seen before come straight from the cache. Otherwise the worker recompiles incrementally
+// into the newest cached engine, so handing the swapped-out engine back with Recycle keeps edits
+// to one segment cheap.
+class BackgroundCompiler {
+public:
+    static constexpr int DEBOUNCE_MS = 120;
+
+    ~BackgroundCompiler() { Stop(); }
+
+    void Stop();
+
+    void Request(const std::string& code);
+    void Cancel(); // E.g. when the text went back to what is already running
+    bool Pending();
+
+    // Hands over the newest result once
+    bool Collect(CompileResult& out);
+    void Recycle(std::unique_ptr<ComplexEngine> engine);
+
+    // Synchronous compile (or cache hit) that also drops any pending request, e.g. for presets
+    void CompileNow(const std::string& code, CompileResult& out);
+
+    ProgramCache& Cache() { return m_cache; }
+
+private:
+    void Run();
+
+    ProgramCache m_cache;
+    std::thread m_thread;
+    bool m_running = false;
+
+    std::mutex m_mutex; // Guards everything below
+    std::condition_variable m_wake;
+    uint64_t m_generation = 0;
+    bool m_requested = false;
+    bool m_compiling = false;
+    std::string m_code;
+    std::chrono::steady_clock::time_point m_due;
+    bool m_ready = false;
+    CompileResult m_result;
+};
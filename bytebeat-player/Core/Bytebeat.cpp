@@ -1,23 +1,23 @@
 ﻿#include "Bytebeat.h"
-#include "GlobalState.h"
 #include <cmath>
 #include <cctype>
 #include <algorithm>
+#include <cfloat>
+#include <charconv>
+#include <cstring>
 #include <string>
 #include <sstream>
+#include <string_view>
 #include <unordered_map>
 #include <mutex> 
 
-using namespace std;
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define LITERAL_SSE2 1
+#endif
 
-// const to differenciate Array ID from String ID
-// Strings have ID 0..199999, Arrays have 200000+
-static const int ARRAY_ID_OFFSET = 200000;
+using namespace std;
 
-// Globals (move to other file later)
-static vector<string> g_strings;
-static vector<vector<double>> g_arrays;
-static recursive_mutex g_bytebeatMutex;
 
 static int getPrecedence(OpType op) {
     switch (op) {
@@ -33,12 +33,259 @@ static int getPrecedence(OpType op) {
     }
 }
 
-bool BytebeatExpression::Compile(const string& expr, string& error, int& errorPos) {
-    lock_guard<recursive_mutex> lock(g_bytebeatMutex);
+int LiteralArena::Append(Kind kind, const void* data, size_t length, size_t elementSize) {
+    Literal lit;
+    lit.kind = kind;
+    lit.length = (uint32_t)length;
+    lit.offset = (m_bytes.size() + elementSize - 1) / elementSize * elementSize;
+    m_bytes.resize(lit.offset + length * elementSize);
+    if (length) memcpy(m_bytes.data() + lit.offset, data, length * elementSize);
+    m_table.push_back(move(lit));
+    return (int)m_table.size() - 1;
+}
+
+int LiteralArena::AddBytes(string_view bytes) {
+    return Append(Kind::Bytes, bytes.data(), bytes.size(), 1);
+}
+
+int LiteralArena::AddArray(const vector<double>& values) {
+    // Integers (but not -0) that fit a byte or an int32 are stored narrower, they read back exactly
+    bool bytes = true, ints = true;
+    for (double v : values) {
+        if (!(v >= INT32_MIN && v <= INT32_MAX) || v != (double)(int32_t)v || (v == 0.0 && signbit(v))) {
+            ints = bytes = false;
+            break;
+        }
+        if (v < 0 || v > 255) bytes = false;
+    }
+    if (bytes) {
+        vector<uint8_t> narrow(values.begin(), values.end());
+        return Append(Kind::Bytes, narrow.data(), narrow.size(), 1);
+    }
+    if (ints) {
+        vector<int32_t> narrow(values.begin(), values.end());
+        return Append(Kind::Int32, narrow.data(), narrow.size(), 4);
+    }
+    return Append(Kind::Float64, values.data(), values.size(), 8);
+}
+
+int LiteralArena::AddSample(SampleData data) {
+    Literal lit;
+    lit.kind = Kind::Bytes;
+    lit.length = (uint32_t)data->size();
+    lit.offset = 0;
+    lit.external = data->data();
+    lit.sample = move(data);
+    m_table.push_back(move(lit));
+    return (int)m_table.size() - 1;
+}
+
+int LiteralArena::Copy(const LiteralArena& from, int id) {
+    const Literal& lit = from.m_table[id];
+    if (lit.external) return AddSample(lit.sample);
+    static const size_t elementSizes[] = { 1, 4, 8 };
+    return Append(lit.kind, from.m_bytes.data() + lit.offset, lit.length, elementSizes[(int)lit.kind]);
+}
+
+void LiteralArena::Truncate(size_t count) {
+    if (count >= m_table.size()) return;
+    for (size_t i = count; i < m_table.size(); i++) {
+        if (!m_table[i].external) {
+            m_bytes.resize(m_table[i].offset);
+            break;
+        }
+    }
+    m_table.resize(count);
+}
+
+void LiteralArena::Clear() {
+    m_table.clear();
+    m_bytes.clear();
+}
+
+size_t LiteralArena::MemoryBytes() const {
+    return m_table.capacity() * sizeof(Literal) + m_bytes.capacity();
+}
+
+static int HexValue(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    return 0;
+}
+
+// Sample data is almost entirely \xNN escapes. Decodes whole blocks of 16 of them (64 input
+// bytes) from src into out and returns the input bytes consumed; it stops at the first block
+// holding anything else, which the caller decodes one escape at a time.
+static size_t DecodeHexEscapes(const char* src, size_t size, string& out) {
+    size_t used = 0;
+#ifdef LITERAL_SSE2
+    // Each 32-bit lane is one escape: '\\', 'x', high digit, low digit
+    const __m128i pattern = _mm_set1_epi32('\\' | ('x' << 8));
+    const __m128i zero = _mm_set1_epi8('0' - 1), nine = _mm_set1_epi8('9' + 1);
+    const __m128i a = _mm_set1_epi8('a' - 1), f = _mm_set1_epi8('f' + 1);
+    const __m128i lower = _mm_set1_epi8(0x20);
+    const __m128i lowByte = _mm_set1_epi32(0xFF);
+    auto decode = [&](const char* p, __m128i& bytes) {
+        __m128i v = _mm_loadu_si128((const __m128i*)p);
+        __m128i l = _mm_or_si128(v, lower); // Digits already have 0x20 set
+        __m128i digit = _mm_and_si128(_mm_cmpgt_epi8(v, zero), _mm_cmplt_epi8(v, nine));
+        __m128i alpha = _mm_and_si128(_mm_cmpgt_epi8(l, a), _mm_cmplt_epi8(l, f));
+        int marks = _mm_movemask_epi8(_mm_cmpeq_epi8(v, pattern)) & 0x3333;
+        int digits = _mm_movemask_epi8(_mm_or_si128(digit, alpha)) & 0xCCCC;
+        if (marks != 0x3333 || digits != 0xCCCC) return false;
+        __m128i nib = _mm_or_si128(
+            _mm_and_si128(digit, _mm_sub_epi8(v, _mm_set1_epi8('0'))),
+            _mm_and_si128(alpha, _mm_sub_epi8(l, _mm_set1_epi8('a' - 10))));
+        __m128i hi = _mm_slli_epi32(_mm_and_si128(_mm_srli_epi32(nib, 16), lowByte), 4);
+        bytes = _mm_or_si128(hi, _mm_srli_epi32(nib, 24));
+        return true;
+    };
+    while (size - used >= 64) {
+        __m128i b0, b1, b2, b3;
+        const char* p = src + used;
+        if (!decode(p, b0) || !decode(p + 16, b1) || !decode(p + 32, b2) || !decode(p + 48, b3)) break;
+        __m128i packed = _mm_packus_epi16(_mm_packs_epi32(b0, b1), _mm_packs_epi32(b2, b3));
+        size_t at = out.size();
+        out.resize(at + 16);
+        _mm_storeu_si128((__m128i*)&out[at], packed);
+        used += 64;
+    }
+#else
+    // Without SSE2 every escape takes the scalar path in ParseStringLiteral
+    (void)src;
+    (void)size;
+    (void)out;
+#endif
+    return used;
+}
+
+size_t ParseStringLiteral(string_view expr, size_t i, string& out) {
+    out.clear();
+    char quote = expr[i++];
+    while (i < expr.size()) {
+        if (expr[i] == quote) break;
+        if (expr[i] != '\\') {
+            // Plain text is copied a run at a time, only escapes are decoded character by character
+            size_t run = i + 1;
+            while (run < expr.size() && expr[run] != quote && expr[run] != '\\') run++;
+            out.append(expr.data() + i, run - i);
+            i = run;
+            continue;
+        }
+        size_t decoded = DecodeHexEscapes(expr.data() + i, expr.size() - i, out);
+        if (decoded) {
+            i += decoded;
+            continue;
+        }
+        i++;
+        if (i >= expr.size()) break;
+        char nextC = expr[i];
+        // Handle \xNN
+        if (nextC == 'x' && i + 2 < expr.size()) {
+            i++;
+            char h1 = expr[i++];
+            char h2 = expr[i++];
+            out += (char)((HexValue(h1) << 4) | HexValue(h2));
+        }
+        else {
+            switch (nextC) {
+                case '0': out += '\0'; break;
+                case 'n': out += '\n'; break;
+                case 'r': out += '\r'; break;
+                case 't': out += '\t'; break;
+                case '\\': out += '\\'; break;
+                case '\'': out += '\''; break;
+                case '"': out += '"'; break;
+                default: out += nextC; break;
+            }
+            i++;
+        }
+    }
+    if (i < expr.size() && expr[i] == quote) i++;
+    return i;
+}
+
+// Keyword tables as switches, so the lexer never builds a string to look a name up
+static bool LookupFunction(string_view name, FunType& fun) {
+    switch (name.size()) {
+    case 3:
+        if (name == "sin") fun = FunType::Sin;
+        else if (name == "cos") fun = FunType::Cos;
+        else if (name == "abs") fun = FunType::Abs;
+        else if (name == "pow") fun = FunType::Pow;
+        else if (name == "tan") fun = FunType::Tan;
+        else return false;
+        return true;
+    case 5:
+        if (name != "floor") return false;
+        fun = FunType::Floor;
+        return true;
+    case 6:
+        if (name != "random") return false;
+        fun = FunType::Random;
+        return true;
+    default:
+        return false;
+    }
+}
+
+// Operator starting at expr[i]; returns its length in characters, 0 if there is none
+static size_t LookupOperator(string_view expr, size_t i, OpType& op) {
+    const char c = expr[i];
+    const char next = i + 1 < expr.size() ? expr[i + 1] : '\0';
+    switch (c) {
+    case '<':
+        if (next == '<') { op = OpType::Shl; return 2; }
+        if (next == '=') { op = OpType::LE; return 2; }
+        op = OpType::LT; return 1;
+    case '>':
+        if (next == '>') { op = OpType::Shr; return 2; }
+        if (next == '=') { op = OpType::GE; return 2; }
+        op = OpType::GT; return 1;
+    case '=':
+        if (next == '=') { op = OpType::EQ; return 2; }
+        op = OpType::Assign; return 1;
+    case '!':
+        if (next == '=') { op = OpType::NE; return 2; }
+        return 0;
+    case '+': op = OpType::Add; return 1;
+    case '-': op = OpType::Sub; return 1;
+    case '*': op = OpType::Mul; return 1;
+    case '/': op = OpType::Div; return 1;
+    case '%': op = OpType::Mod; return 1;
+    case '&': op = OpType::And; return 1;
+    case '|': op = OpType::Or; return 1;
+    case '^': op = OpType::Xor; return 1;
+    case ',': op = OpType::Coma; return 1;
+    default: return 0;
+    }
+}
+
+// Number at expr[i] in an array literal, read the way stod() did: decimal or 0x hex with an
+// optional '-'. Returns the index past it, or i where stod threw (no number, out of range).
+static size_t ParseArrayNumber(string_view expr, size_t i, double& val) {
+    const char* first = expr.data() + i;
+    const char* last = expr.data() + expr.size();
+    const bool negative = *first == '-';
+    const char* digits = first + (negative ? 1 : 0);
+    from_chars_result res{ first, errc::invalid_argument };
+    // "0x" only makes a hex number when hex digits follow, otherwise stod read the "0" alone
+    if (last - digits > 2 && digits[0] == '0' && (digits[1] == 'x' || digits[1] == 'X') && (isxdigit((unsigned char)digits[2]) || digits[2] == '.')) {
+        res = from_chars(digits + 2, last, val, chars_format::hex);
+        if (res.ec == errc()) val = negative ? -val : val;
+    }
+    if (res.ec == errc::invalid_argument) res = from_chars(first, last, val);
+    // ERANGE made stod throw, subnormal results included
+    if (res.ec != errc() || (val != 0.0 && fabs(val) < DBL_MIN)) return i;
+    return (size_t)(res.ptr - expr.data());
+}
 
+bool BytebeatExpression::Compile(string_view expr, string& error, int& errorPos, BytebeatVM& vm) {
     error.clear();
     errorPos = -1;
     m_rpn.clear();
+    m_vm = &vm;
 
     if (expr.empty()) return false;
 
@@ -46,27 +293,14 @@ bool BytebeatExpression::Compile(const string& expr, string& error, int& errorPo
     vector<Token> stack;
     bool expectUnary = true;
 
-    static const unordered_map<string, FunType> funMap = {
-        {"sin", FunType::Sin}, {"cos", FunType::Cos},
-        {"abs", FunType::Abs}, {"floor", FunType::Floor},
-        {"pow", FunType::Pow}, {"tan", FunType::Tan}, 
-        {"random", FunType::Random}
-    };
-    static const unordered_map<string, OpType> doubleOps = {
-        {"<<", OpType::Shl}, {">>", OpType::Shr}, 
-        {"<=", OpType::LE}, {">=", OpType::GE}, 
-        {"==", OpType::EQ}, {"!=", OpType::NE}
-    };
-    static const unordered_map<char, OpType> singleOps = {
-        {'+', OpType::Add}, {'-', OpType::Sub},
-        {'*', OpType::Mul}, {'/', OpType::Div},
-        {'%', OpType::Mod}, {'&', OpType::And},
-        {'|', OpType::Or}, {'^', OpType::Xor},
-        {'<', OpType::LT}, {'>', OpType::GT},
-        {'=', OpType::Assign}, {',', OpType::Coma}
+    // Tokens get their span once the next token starts (or the input ends)
+    size_t spanned = 0;
+    auto closeSpans = [&tokens, &spanned](size_t end) {
+        for (; spanned < tokens.size(); spanned++) tokens[spanned].len = (int)end - tokens[spanned].pos;
     };
 
     for (size_t i = 0; i < expr.size(); ) {
+        closeSpans(i);
         if (isspace((unsigned char)expr[i])) {
             i++;
             continue;
@@ -88,13 +322,14 @@ bool BytebeatExpression::Compile(const string& expr, string& error, int& errorPo
             expectUnary = false;
         }
         else if (isalpha((unsigned char)expr[i]) || expr[i] == '_') {
-            string name;
             while (i < expr.size() && 
                 (isalnum((unsigned char)expr[i]) || expr[i] == '_'))
-                name += expr[i++];
+                i++;
+            string_view name = expr.substr(start, i - start);
 
+            FunType fun;
             if (name == "t") tokens.emplace_back(TokType::VarT, start);
-            else if (funMap.count(name)) tokens.emplace_back(funMap.at(name), start);
+            else if (LookupFunction(name, fun)) tokens.emplace_back(fun, start);
             else {
                 size_t j = i;
                 while (j < expr.size() && isspace((unsigned char)expr[j])) j++;
@@ -103,55 +338,49 @@ bool BytebeatExpression::Compile(const string& expr, string& error, int& errorPo
                     (j + 1 >= expr.size() || expr[j + 1] != '='))
                     isAssign = true;
 
-                int id = state.getVarId(name);
+                int id = vm.getVarId(name);
                 tokens.emplace_back(id, start, isAssign);
             }
             expectUnary = false;
         }
         // HEX parser for strings
         else if (expr[i] == '\'' || expr[i] == '"') {
-            char quote = expr[i++];
             string s;
-            while (i < expr.size()) {
-                if (expr[i] == quote) break;
-                if (expr[i] == '\\') {
-                    i++;
-                    if (i >= expr.size()) break;
-                    char nextC = expr[i];
-                    // Handle \xNN
-                    if (nextC == 'x' && i + 2 < expr.size()) {
-                        i++;
-                        char h1 = expr[i++];
-                        char h2 = expr[i++];
-                        auto hexVal = [](char c) -> int {
-                            if (c >= '0' && c <= '9') return c - '0';
-                            if (c >= 'A' && c <= 'F') return c - 'A' + 10;
-                            if (c >= 'a' && c <= 'f') return c - 'a' + 10;
-                            return 0;
-                        };
-                        char byteVal = (char)((hexVal(h1) << 4) | hexVal(h2));
-                        s += byteVal;
-                    }
-                    else {
-                        switch (nextC) {
-                            case '0': s += '\0'; break;
-                            case 'n': s += '\n'; break;
-                            case 'r': s += '\r'; break;
-                            case 't': s += '\t'; break;
-                            case '\\': s += '\\'; break;
-                            case '\'': s += '\''; break;
-                            case '"': s += '"'; break;
-                            default: s += nextC; break;
-                        }
-                        i++;
-                    }
+            i = ParseStringLiteral(expr, i, s);
+            Token t(TokType::String, start);
+            t.index = vm.literals.AddBytes(s);
+            tokens.push_back(t);
+            expectUnary = false;
+        }
+        // Binary sample asset @sample(N) or hidden string literal @chunk(N)
+        else if (expr[i] == '@') {
+            const bool isChunk = expr.compare(i, 7, "@chunk(") == 0;
+            const string_view prefix = isChunk ? "@chunk(" : "@sample(";
+            size_t j = i + prefix.size();
+            int id = 0;
+            bool digits = false;
+            if (expr.compare(i, prefix.size(), prefix) == 0) {
+                while (j < expr.size() && isdigit((unsigned char)expr[j]) && id < 100000) {
+                    id = id * 10 + (expr[j++] - '0');
+                    digits = true;
                 }
-                else s += expr[i++];
             }
-            if (i < expr.size() && expr[i] == quote) i++;
-            g_strings.push_back(s);
+            bool closed = digits && j < expr.size() && expr[j] == ')';
+            SampleData data = nullptr;
+            if (closed && isChunk) {
+                ChunkData chunk = GetChunk(id);
+                if (chunk) data = chunk->bytes;
+            }
+            else if (closed) data = GetSample(id);
+            if (!data) {
+                string kind = isChunk ? "chunk" : "sample";
+                error = closed ? "Unknown " + kind + " " + string(prefix) + to_string(id) + ")" : "Expected " + string(prefix) + "N)";
+                errorPos = start;
+                return false;
+            }
+            i = j + 1;
             Token t(TokType::String, start);
-            t.index = (int)g_strings.size() - 1;
+            t.index = vm.literals.AddSample(move(data));
             tokens.push_back(t);
             expectUnary = false;
         }
@@ -165,22 +394,20 @@ bool BytebeatExpression::Compile(const string& expr, string& error, int& errorPo
                         continue;
                     }
                     if (isdigit((unsigned char)expr[i]) || expr[i] == '-' || expr[i] == '.') {
-                        size_t nextIdx;
-                        try {
-                            double val = stod(expr.substr(i), &nextIdx);
+                        double val;
+                        size_t next = ParseArrayNumber(expr, i, val);
+                        if (next == i) i++;
+                        else {
                             arr.push_back(val);
-                            i += nextIdx;
+                            i = next;
                         }
-                        catch (...) { i++; }
                     }
                     else i++;
                 }
                 if (i < expr.size()) i++;
 
-                g_arrays.push_back(arr);
                 Token t(TokType::ArrayLiteral, start);
-                // offset for Eval to differenciate array (200000) from string (0)
-                t.index = (int)g_arrays.size() - 1 + ARRAY_ID_OFFSET;
+                t.index = vm.literals.AddArray(arr);
                 tokens.push_back(t);
                 expectUnary = false;
             }
@@ -203,13 +430,13 @@ bool BytebeatExpression::Compile(const string& expr, string& error, int& errorPo
         else if (expr[i] == '~') { tokens.emplace_back(OpType::BitNot, start); i++; expectUnary = true; }
         else {
             if (expr[i] == '.') {
-                if ((i + 10 < expr.size()) && expr.substr(i, 11) == ".charCodeAt") {
+                if (expr.compare(i, 11, ".charCodeAt") == 0) {
                     tokens.emplace_back(OpType::CharCodeAt, start);
                     i += 11;
                     expectUnary = true;
                     continue;
                 }
-                if ((i + 6 < expr.size()) && expr.substr(i, 7) == ".length") {
+                if (expr.compare(i, 7, ".length") == 0) {
                     tokens.emplace_back(OpType::Length, start);
                     i += 7;
                     expectUnary = false;
@@ -223,33 +450,23 @@ bool BytebeatExpression::Compile(const string& expr, string& error, int& errorPo
             }
             else {
                 OpType ot = OpType::Add;
-                bool found = false;
-                if (i + 1 < expr.size()) {
-                    string two = expr.substr(i, 2);
-                    if (doubleOps.count(two)) {
-                        ot = doubleOps.at(two);
-                        i += 2;
-                        found = true;
-                    }
-                }
-                if (!found) {
-                    if (singleOps.count(expr[i])) {
-                        ot = singleOps.at(expr[i]);
-                        i++;
-                    }
-                    else {
-                        error = "Unexpected token: '" + string(1, expr[i]) + "'";
-                        errorPos = start;
-                        return false;
-                    }
+                size_t length = LookupOperator(expr, i, ot);
+                if (length == 0) {
+                    error = "Unexpected token: '" + string(1, expr[i]) + "'";
+                    errorPos = start;
+                    return false;
                 }
+                i += length;
                 tokens.emplace_back(ot, start);
                 expectUnary = true;
             }
         }
     }
 
+    closeSpans(expr.size());
+
     // Shunting-yard Algorithm
+    m_rpn.reserve(tokens.size());
     for (const auto& t : tokens) {
         if (t.type == TokType::Number ||
             t.type == TokType::VarT ||
@@ -334,18 +551,110 @@ bool BytebeatExpression::Compile(const string& expr, string& error, int& errorPo
         error = "Empty expression";
         return false;
     }
+    FuseWrappedLookups();
     return true;
 }
 
-double BytebeatExpression::Eval(uint32_t t) const {
-    lock_guard<recursive_mutex> lock(g_bytebeatMutex);
+// Values a token pops and pushes in Eval
+static void StackEffect(const Token& tok, int& pops, int& pushes) {
+    pushes = 1;
+    switch (tok.type) {
+    case TokType::Fun: pops = tok.fun == FunType::Pow ? 2 : tok.fun == FunType::Random ? 0 : 1; break;
+    case TokType::Colon: pops = 3; break;
+    case TokType::Quest: pops = pushes = 0; break;
+    case TokType::Op: pops = (tok.op == OpType::Neg || tok.op == OpType::BitNot || tok.op == OpType::Length) ? 1 : 2; break;
+    default: pops = 0; break;
+    }
+}
+
+// Sample playback, h.charCodeAt(x % h.length) or h[x % h.length] with any offset or speed in x,
+// is compiled to RPN "h x h length % index". That becomes "h x wrapindex": one opcode that reads
+// h once and wraps x with an integer remainder when it can.
+void BytebeatExpression::FuseWrappedLookups() {
+    // Eval skips operators that would underflow (functions need an operand, even random) and stops
+    // near 1024 values; only fuse programs that stay clear of both, so results can't change
+    int depth = 0;
+    for (const Token& tok : m_rpn) {
+        int pops, pushes;
+        StackEffect(tok, pops, pushes);
+        if (depth < pops || (tok.type == TokType::Fun && depth < 1)) return;
+        depth += pushes - pops;
+        if (depth >= 1000) return;
+    }
+
+    vector<Token> out;
+    out.reserve(m_rpn.size());
+    for (const Token& tok : m_rpn) {
+        out.push_back(tok);
+        const size_t n = out.size();
+        if (tok.type != TokType::Op || (tok.op != OpType::CharCodeAt && tok.op != OpType::Index) || n < 6) continue;
+        const Token& mod = out[n - 2];
+        const Token& length = out[n - 3];
+        const Token& handle = out[n - 4];
+        if (mod.type != TokType::Op || mod.op != OpType::Mod ||
+            length.type != TokType::Op || length.op != OpType::Length ||
+            handle.type != TokType::Identifier) continue;
+
+        // Walk back over x to the operand below it. x must not assign: h is read before and after it.
+        size_t j = n - 5;
+        int need = 1;
+        bool pure = true;
+        while (need > 0) {
+            int pops, pushes;
+            StackEffect(out[j], pops, pushes);
+            if (out[j].type == TokType::VarPtr || (out[j].type == TokType::Op && out[j].op == OpType::Assign)) pure = false;
+            need += pops - pushes;
+            if (need <= 0 || j == 0) break;
+            j--;
+        }
+        if (need != 0 || !pure || j == 0) continue;
+        const Token& first = out[j - 1];
+        if (first.type != TokType::Identifier || first.index != handle.index) continue;
+
+        Token fused(OpType::WrapIndex, tok.pos);
+        fused.len = tok.len;
+        out.resize(n - 4);
+        out.push_back(fused);
+    }
+    m_rpn = move(out);
+}
+
+void BytebeatExpression::Relocate(BytebeatVM& from, BytebeatVM& to) {
+    // Operands leave shunting-yard in source order, so this appends literals in the order Compile did
+    for (Token& tok : m_rpn) {
+        if (tok.type == TokType::String || tok.type == TokType::ArrayLiteral) tok.index = to.literals.Copy(from.literals, tok.index);
+    }
+    m_vm = &to;
+}
 
+bool BytebeatExpression::UsesTime() const {
+    for (const Token& tok : m_rpn) {
+        if (tok.type == TokType::VarT || (tok.type == TokType::Fun && tok.fun == FunType::Random)) return true;
+    }
+    return false;
+}
+
+bool BytebeatExpression::Assigns() const {
+    for (const Token& tok : m_rpn) {
+        if (tok.type == TokType::VarPtr || (tok.type == TokType::Op && tok.op == OpType::Assign)) return true;
+    }
+    return false;
+}
+
+void BytebeatExpression::Reads(vector<int>& ids) const {
+    for (const Token& tok : m_rpn) {
+        if (tok.type == TokType::Identifier) ids.push_back(tok.index);
+    }
+}
+
+double BytebeatExpression::Eval(uint32_t t) const {
     if (m_rpn.empty()) return 0.0;
     double stack[1024];
     int sp = -1;
 
     // Cache index to memory
-    const vector<double>& memory = state.vmMemory;
+    vector<double>& memory = m_vm->memory;
+    const LiteralArena& literals = m_vm->literals;
 
     for (const auto& tok : m_rpn) {
         if (sp >= 1023) break; // Security
@@ -354,8 +663,8 @@ double BytebeatExpression::Eval(uint32_t t) const {
         case TokType::Number: stack[++sp] = tok.value; break;
         case TokType::VarT: stack[++sp] = (double)t; break;
         case TokType::Identifier: stack[++sp] = memory[tok.index]; break;
-        case TokType::String: stack[++sp] = (double)tok.index; break;
-        case TokType::ArrayLiteral: stack[++sp] = (double)tok.index; break;
+        case TokType::String: stack[++sp] = LiteralArena::Handle(tok.index); break;
+        case TokType::ArrayLiteral: stack[++sp] = LiteralArena::Handle(tok.index); break;
         case TokType::VarPtr: stack[++sp] = (double)tok.index; break; // Throw var ID to stack
         case TokType::Fun:
             if (sp >= 0) {
@@ -391,65 +700,38 @@ double BytebeatExpression::Eval(uint32_t t) const {
                 if (sp >= 0) stack[sp] = -stack[sp];
             }
             else if (tok.op == OpType::BitNot) {
-                if (sp >= 0) stack[sp] = (double)(~(int64_t)stack[sp]);
+                if (sp >= 0) stack[sp] = (double)(~ToInt64(stack[sp]));
             }
             else if (tok.op == OpType::Assign) {
                 if (sp >= 1) {
                     double val = stack[sp--];
                     double ptr = stack[sp];
-                    int idx = (int)ptr;
-                    if (idx >= 0 && idx < memory.size()) const_cast<vector<double>&>(memory)[idx] = val;
+                    int idx = ToInt32(ptr);
+                    if (idx >= 0 && idx < memory.size()) memory[idx] = val;
                     stack[sp] = val;
                 }
             }
             else if (tok.op == OpType::Length) {
-                if (sp >= 0) {
-                    double targetId = stack[sp];
-                    int tId = (int)targetId;
-                    int len = 0;
-
-                    if (tId >= ARRAY_ID_OFFSET) {
-                        int arrIdx = tId - ARRAY_ID_OFFSET;
-                        if (arrIdx >= 0 && arrIdx < g_arrays.size()) len = (int)g_arrays[arrIdx].size();
-                    }
-                    else if (tId >= 0 && tId < g_strings.size()) len = (int)g_strings[tId].size();
-                    stack[sp] = (double)len;
-                }
+                if (sp >= 0) stack[sp] = literals.Length(stack[sp]);
             }
             else if (tok.op == OpType::Index || tok.op == OpType::CharCodeAt) {
                 if (sp >= 1) {
                     double idxVal = stack[sp--];
-                    double targetId = stack[sp];
-                    int tId = (int)targetId;
-
-                    if (tId >= ARRAY_ID_OFFSET) {
-                        int arrIndex = tId - ARRAY_ID_OFFSET;
-                        if (arrIndex >= 0 && arrIndex < g_arrays.size()) {
-                            const vector<double>& arr = g_arrays[arrIndex];
-                            int i = (int)idxVal;
-                            if (i >= 0 && i < arr.size()) stack[sp] = arr[i];
-                            else stack[sp] = 0;
-                        }
-                        else stack[sp] = 0;
-                    }
-                    else {
-                        if (tId >= 0 && tId < g_strings.size()) {
-                            const string& s = g_strings[tId];
-                            int i = (int)idxVal;
-                            // FIX: Cast to unsigned char to avoid negative numbers for special chars
-                            if (i >= 0 && i < s.size()) stack[sp] = (double)(unsigned char)s[i];
-                            else stack[sp] = 0;
-                        }
-                        else stack[sp] = 0;
-                    }
+                    stack[sp] = literals.Load(stack[sp], idxVal);
+                }
+            }
+            else if (tok.op == OpType::WrapIndex) {
+                if (sp >= 1) {
+                    double idxVal = stack[sp--];
+                    stack[sp] = literals.LoadWrapped(stack[sp], idxVal);
                 }
             }
             else if (sp >= 1) {
                 double b = stack[sp--];
                 double& a = stack[sp];
 
-                int32_t ia = (int32_t)a;
-                int32_t ib = (int32_t)b;
+                int32_t ia = ToInt32(a);
+                int32_t ib = ToInt32(b);
 
                 switch (tok.op) {
                 case OpType::Add: a += b; break;
@@ -481,162 +763,299 @@ double BytebeatExpression::Eval(uint32_t t) const {
     return (sp >= 0) ? stack[0] : 0.0;
 }
 
-bool ComplexEngine::Compile(const string& code, string& err, int& errorPos) {
-    lock_guard<recursive_mutex> lock(g_bytebeatMutex);
-
-    // Ensure that variables are reset and IDs are consistent
-    state.resetVM();
-
-    instructions.clear();
-    g_strings.clear();
-    g_arrays.clear();
-
-    errorPos = -1;
-
-    struct SegmentData {
-        string text;
-        size_t offset;
-    };
-    vector<SegmentData> segments;
+// Index of the quote closing a literal whose text starts at i, or code.size() if it is
+// unterminated. A quote is escaped when an odd run of backslashes precedes it, so big data
+// literals are skipped with memchr instead of walking every escape.
+static size_t FindClosingQuote(string_view code, size_t i, char quote) {
+    while (i < code.size()) {
+        const char* hit = (const char*)memchr(code.data() + i, quote, code.size() - i);
+        if (!hit) break;
+        size_t q = (size_t)(hit - code.data());
+        size_t slashes = 0;
+        while (q - slashes > i && code[q - 1 - slashes] == '\\') slashes++;
+        if (slashes % 2 == 0) return q;
+        i = q + 1;
+    }
+    return code.size();
+}
 
-    string currentSeg;
+// SMART SPLIT: Breaking down into instructions
+vector<ComplexEngine::Segment> ComplexEngine::Split(string_view code) {
+    vector<Segment> segments;
     size_t currentSegStart = 0;
     int parenDepth = 0;
     int bracketDepth = 0;
-    bool inQuote = false;
-    char quoteChar = 0;
 
-    // SMART SPLIT: Breaking down into instructions
     for (size_t i = 0; i < code.size(); i++) {
         char c = code[i];
-        if (inQuote) {
-            currentSeg += c;
-            if (c == '\\' && i + 1 < code.size()) currentSeg += code[++i];
-            else if (c == quoteChar) inQuote = false;
+        if (c == '"' || c == '\'') i = FindClosingQuote(code, i + 1, c);
+        else if (c == '(') parenDepth++;
+        else if (c == ')') { if (parenDepth > 0) parenDepth--; }
+        else if (c == '[') bracketDepth++;
+        else if (c == ']') { if (bracketDepth > 0) bracketDepth--; }
+        else if (c == ',' && parenDepth == 0 && bracketDepth == 0) {
+            if (i > currentSegStart) segments.push_back({ code.substr(currentSegStart, i - currentSegStart), currentSegStart });
+            currentSegStart = i + 1;
         }
-        else {
-            if (c == '"' || c == '\'') { 
-                inQuote = true; 
-                quoteChar = c; 
-                currentSeg += c; 
-            }
-            else if (c == '(') {
-                parenDepth++;
-                currentSeg += c;
-            }
-            else if (c == ')') {
-                if (parenDepth > 0) parenDepth--;
-                currentSeg += c; 
-            }
-            else if (c == '[') {
-                bracketDepth++; 
-                currentSeg += c;
-            }
-            else if (c == ']') { 
-                if (bracketDepth > 0) bracketDepth--;
-                currentSeg += c;
-            }
-            else if (c == ',') {
-                if (parenDepth == 0 && bracketDepth == 0) {
-                    if (!currentSeg.empty()) segments.push_back({ currentSeg, currentSegStart });
-                    currentSeg.clear();
-                    currentSegStart = i + 1;
+    }
+    if (code.size() > currentSegStart) segments.push_back({ code.substr(currentSegStart), currentSegStart });
+    return segments;
+}
+
+bool ComplexEngine::CompileSegment(const Segment& seg, Instruction& ins, string& err, int& errorPos, BytebeatVM& target) {
+    string_view segment = seg.text;
+    size_t segOffset = seg.offset;
+    ins.source = segment;
+
+    // SMART ASSIGN DETECT: Ignore '=' inside ()
+    size_t assignPos = string::npos;
+    bool isAssign = false;
+
+    int pDepth = 0; 
+    for (size_t i = 0; i < segment.size(); ++i) {
+        char c = segment[i];
+        if (c == '"' || c == '\'') i = FindClosingQuote(segment, i + 1, c);
+        else if (c == '(') pDepth++;
+        else if (c == ')' && pDepth > 0) pDepth--;
+        else if (c == '=') {
+            if (pDepth == 0) {
+                bool logic = false;
+                if (i > 0 && 
+                    (segment[i - 1] == '!' ||
+                    segment[i - 1] == '=' ||
+                    segment[i - 1] == '<' ||
+                    segment[i - 1] == '>')) 
+                    logic = true;
+
+                if (i + 1 < segment.size() && segment[i + 1] == '=') logic = true;
+                if (!logic) { 
+                    isAssign = true; 
+                    assignPos = i;
+                    break; 
                 }
-                else currentSeg += c;
             }
-            else currentSeg += c;
         }
     }
-    if (!currentSeg.empty()) segments.push_back({ currentSeg, currentSegStart });
+    int localEp = -1;
+
+    if (isAssign) {
+        ins.type = Instruction::Type::AssignVar;
+        string varName(segment.substr(0, assignPos));
+
+        varName.erase(remove_if(varName.begin(), varName.end(), [](char c) {
+            return isspace(static_cast<unsigned char>(c));
+        }), varName.end());
 
-    for (auto& segData : segments) {
-        string& segment = segData.text;
-        size_t segOffset = segData.offset;
+        // Get index for allocated variable
+        ins.targetVarIdx = target.getVarId(varName);
 
-        if (segment.find_first_not_of(" \t\n\r") == string::npos) continue;
+        if (!ins.expr.Compile(segment.substr(assignPos + 1), err, localEp, target)) {
+            errorPos = (int)(segOffset + assignPos + 1 + localEp);
+            return false;
+        }
+    }
+    else {
+        ins.type = Instruction::Type::EvalExpr;
+        if (!ins.expr.Compile(segment, err, localEp, target)) {
+            errorPos = (int)(segOffset + localEp);
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool IsBlank(string_view segment) {
+    return segment.find_first_not_of(" \t\n\r") == string_view::npos;
+}
+
+bool ComplexEngine::CompileAll(const string& code, string& err, int& errorPos) {
+    // Ensure that variables are reset and IDs are consistent
+    vm.reset();
+    instructions.clear();
+    m_source = make_unique<const string>(code);
+
+    errorPos = -1;
+    for (const Segment& seg : Split(*m_source)) {
+        if (IsBlank(seg.text)) continue;
         Instruction ins;
+        if (!CompileSegment(seg, ins, err, errorPos, vm)) return false;
+        instructions.push_back(move(ins));
+    }
+    return !instructions.empty();
+}
 
-        // SMART ASSIGN DETECT: Ignore '=' inside ()
-        size_t assignPos = string::npos;
-        bool isAssign = false;
-
-        int pDepth = 0; 
-        bool q = false;
-        char qc = 0;
-        for (size_t i = 0; i < segment.size(); ++i) {
-            char c = segment[i];
-            if (q) {
-                if (c == '\\' && i + 1 < segment.size()) i++;
-                else if (c == qc) q = false;
-            }
-            else {
-                if (c == '"' || c == '\'') { 
-                    q = true; 
-                    qc = c; 
-                }
-                else if (c == '(') pDepth++;
-                else if (c == ')' && pDepth > 0) pDepth--;
-                else if (c == '=') {
-                    if (pDepth == 0) {
-                        bool logic = false;
-                        if (i > 0 && 
-                            (segment[i - 1] == '!' ||
-                            segment[i - 1] == '<' ||
-                            segment[i - 1] == '>')) 
-                            logic = true;
-
-                        if (i + 1 < segment.size() && segment[i + 1] == '=') logic = true;
-                        if (!logic) { 
-                            isAssign = true; 
-                            assignPos = i;
-                            break; 
-                        }
-                    }
-                }
-            }
+bool ComplexEngine::Compile(const string& code, string& err, int& errorPos) {
+    lock_guard<mutex> lock(m_mutex);
+    m_compiled = CompileAll(code, err, errorPos);
+    if (m_compiled) {
+        MarkInvariants();
+        RunInvariants();
+    }
+    return m_compiled;
+}
+
+void ComplexEngine::MarkInvariants() {
+    // '=' inside an expression can write any slot, so then no variable is safe to pin
+    bool assigns = false;
+    for (const auto& ins : instructions) assigns = assigns || ins.expr.Assigns();
+
+    const size_t vars = vm.memory.size();
+    vector<int> writers(vars, 0);
+    for (const auto& ins : instructions) {
+        if (ins.type == Instruction::Type::AssignVar && ins.targetVarIdx >= 0 && ins.targetVarIdx < (int)vars) writers[ins.targetVarIdx]++;
+    }
+
+    // A variable is constant when a single invariant instruction sets it and nothing before that
+    // instruction reads it (those would see the old value on the first sample)
+    vector<bool> constant(vars, false), read(vars, false);
+    vector<int> reads;
+    for (auto& ins : instructions) {
+        reads.clear();
+        ins.expr.Reads(reads);
+        bool invariant = !ins.expr.UsesTime() && !ins.expr.Assigns();
+        for (int id : reads) {
+            if (id < 0 || id >= (int)vars) { invariant = false; continue; }
+            if (!constant[id]) invariant = false;
+            read[id] = true;
         }
-        int localEp = -1;
+        if (ins.type == Instruction::Type::AssignVar) {
+            int target = ins.targetVarIdx;
+            invariant = invariant && !assigns && target >= 0 && target < (int)vars && writers[target] == 1 && !read[target];
+            if (invariant) constant[target] = true;
+        }
+        ins.invariant = invariant;
+    }
+}
 
-        if (isAssign) {
-            ins.type = Instruction::Type::AssignVar;
-            string varName = segment.substr(0, assignPos);
+void ComplexEngine::RunInvariants() {
+    for (auto& ins : instructions) {
+        if (!ins.invariant) continue;
+        ins.value = ins.expr.Eval(0);
+        if (ins.type == Instruction::Type::AssignVar) vm.memory[ins.targetVarIdx] = ins.value;
+    }
+}
 
-            varName.erase(remove_if(varName.begin(), varName.end(), [](char c) {
-                return isspace(static_cast<unsigned char>(c));
-            }), varName.end());
+bool ComplexEngine::Recompile(const string& code, string& err, int& errorPos) {
+    lock_guard<mutex> lock(m_mutex);
+    err.clear();
+    errorPos = -1;
 
-            // Get index for allocated variable
-            ins.targetVarIdx = state.getVarId(varName);
+    // Segments point into the new copy of the code, which replaces the old one on success
+    auto source = make_unique<const string>(code);
+    vector<Segment> segments = Split(*source);
+    segments.erase(remove_if(segments.begin(), segments.end(), [](const Segment& seg) { return IsBlank(seg.text); }), segments.end());
+    if (segments.empty()) return false;
 
-            if (!ins.expr.Compile(segment.substr(assignPos + 1), err, localEp)) {
-                errorPos = (int)(segOffset + assignPos + 1 + localEp);
-                return false;
-            }
+    // Unchanged segments keep their compiled instruction. An edit usually leaves a common prefix
+    // and suffix in place; only the segments between them are matched by source text.
+    const size_t oldCount = instructions.size(), newCount = segments.size();
+    size_t prefix = 0, suffix = 0;
+    while (prefix < min(oldCount, newCount) && instructions[prefix].source == segments[prefix].text) prefix++;
+    while (suffix < min(oldCount, newCount) - prefix &&
+        instructions[oldCount - 1 - suffix].source == segments[newCount - 1 - suffix].text) suffix++;
+
+    unordered_map<string_view, vector<size_t>> previous;
+    for (size_t i = oldCount - suffix; i-- > prefix; ) previous[instructions[i].source].push_back(i);
+
+    // Edited segments append their literals after the current ones; on error those are cut off
+    // again so the running program stays intact (new variables just keep an unused slot)
+    const size_t literals = vm.literals.Count();
+    vector<Instruction> compiled;
+    vector<pair<bool, size_t>> plan; // (reused, index into instructions or compiled)
+
+    for (size_t k = 0; k < newCount; k++) {
+        const Segment& seg = segments[k];
+        if (k < prefix || k >= newCount - suffix) {
+            plan.emplace_back(true, k < prefix ? k : oldCount - (newCount - k));
+            continue;
         }
-        else {
-            ins.type = Instruction::Type::EvalExpr;
-            if (!ins.expr.Compile(segment, err, localEp)) {
-                errorPos = (int)(segOffset + localEp);
-                return false;
-            }
+        auto it = previous.find(seg.text);
+        if (it != previous.end() && !it->second.empty()) {
+            plan.emplace_back(true, it->second.back());
+            it->second.pop_back();
+            continue;
         }
-        instructions.push_back(ins);
+        Instruction ins;
+        if (!CompileSegment(seg, ins, err, errorPos, vm)) {
+            vm.literals.Truncate(literals);
+            return false;
+        }
+        plan.emplace_back(false, compiled.size());
+        compiled.push_back(move(ins));
     }
-    return !instructions.empty();
+
+    // Rebuild the literal arena in program order by copying each instruction's literals, so
+    // handles match a full Compile of the same code
+    BytebeatVM old;
+    swap(old.literals, vm.literals);
+    vector<Instruction> next;
+    next.reserve(plan.size());
+    for (size_t k = 0; k < plan.size(); k++) {
+        next.push_back(plan[k].first ? move(instructions[plan[k].second]) : move(compiled[plan[k].second]));
+        next.back().expr.Relocate(old, vm);
+        next.back().source = segments[k].text;
+    }
+    instructions = move(next);
+    m_source = move(source);
+    m_compiled = true;
+    MarkInvariants();
+    RunInvariants();
+    return true;
+}
+
+void ComplexEngine::Swap(ComplexEngine& other, bool keepVariables) {
+    if (&other == this) return;
+    scoped_lock lock(m_mutex, other.m_mutex);
+    swap(instructions, other.instructions);
+    swap(vm, other.vm);
+    swap(m_source, other.m_source);
+    swap(m_compiled, other.m_compiled);
+    for (auto& ins : instructions) ins.expr.Bind(vm);
+    for (auto& ins : other.instructions) ins.expr.Bind(other.vm);
+
+    if (!keepVariables) return;
+    for (const auto& var : vm.varTable) {
+        auto it = other.vm.varTable.find(var.first);
+        if (it != other.vm.varTable.end()) vm.memory[var.second] = other.vm.memory[it->second];
+    }
+    RunInvariants();
+}
+
+const string& ComplexEngine::Source() const {
+    static const string none;
+    return m_compiled && m_source ? *m_source : none;
+}
+
+void ComplexEngine::ResetVariables() {
+    lock_guard<mutex> lock(m_mutex);
+    fill(vm.memory.begin(), vm.memory.end(), 0.0);
+    RunInvariants();
+}
+
+size_t ComplexEngine::MemoryBytes() {
+    lock_guard<mutex> lock(m_mutex);
+    size_t bytes = sizeof(ComplexEngine) + (m_source ? m_source->capacity() : 0) + vm.memory.capacity() * sizeof(double);
+    for (const auto& ins : instructions) bytes += sizeof(Instruction) + ins.expr.MemoryBytes();
+    bytes += vm.literals.MemoryBytes();
+    return bytes;
 }
 
 int ComplexEngine::Eval(uint32_t t) {
-    lock_guard<recursive_mutex> lock(g_bytebeatMutex);
+    lock_guard<mutex> lock(m_mutex);
     double lastVal = 0;
 
     // Check vmMemory size
-    const vector<double>& memory = state.vmMemory;
+    vector<double>& memory = vm.memory;
 
     for (auto& ins : instructions) {
+        if (ins.invariant) {
+            lastVal = ins.value;
+            continue;
+        }
         lastVal = ins.expr.Eval(t);
         if (ins.type == Instruction::Type::AssignVar &&
             ins.targetVarIdx >= 0 && ins.targetVarIdx < memory.size()) 
-            state.vmMemory[ins.targetVarIdx] = lastVal;
+            memory[ins.targetVarIdx] = lastVal;
     }
-    return (int)((int32_t)lastVal & 0xFF);
+    return (int)(ToInt32(lastVal) & 0xFF);
 }
\ No newline at end of file
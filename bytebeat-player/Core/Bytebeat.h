@@ -1,11 +1,17 @@
 ﻿#pragma once
 #include <string>
+#include <string_view>
 #include <vector>
+#include <cmath>
 #include <cstdint>
+#include <cstring>
 #include <map>
+#include <memory>
+#include <mutex>
+#include "Samples.h"
 
 enum class TokType { Number, VarT, Op, LParen, RParen, Fun, Quest, Colon, Identifier, String, ArrayLiteral, VarPtr };
-enum class OpType { Add, Sub, Mul, Div, Mod, And, Or, Xor, Shl, Shr, Neg, BitNot, LT, GT, LE, GE, EQ, NE, Ternary, Assign, Coma, CharCodeAt, Index, Length };
+enum class OpType { Add, Sub, Mul, Div, Mod, And, Or, Xor, Shl, Shr, Neg, BitNot, LT, GT, LE, GE, EQ, NE, Ternary, Assign, Coma, CharCodeAt, Index, Length, WrapIndex };
 enum class FunType { Sin, Cos, Abs, Floor, Tan, Pow, Random };
 
 struct Token {
@@ -14,6 +20,7 @@ struct Token {
     OpType op = OpType::Add;
     FunType fun = FunType::Sin;
     int pos = -1;
+    int len = 0; // Span in the source, [pos, pos + len)
     int index = -1;
 
     Token() = default;
@@ -25,12 +32,137 @@ struct Token {
     Token(int idx, int p, bool isPtr) : type(isPtr ? TokType::VarPtr : TokType::Identifier), index(idx), pos(p) {}
 };
 
+// Truncating conversions with the result x86 gives (cvttsd2si): NaN and values out of range
+// become the minimum. A plain cast is undefined there, and literal handles (2^40 and up) or
+// large t products reach the bitwise operators and the output byte.
+inline int32_t ToInt32(double v) {
+    return v > -2147483649.0 && v < 2147483648.0 ? (int32_t)v : INT32_MIN;
+}
+inline int64_t ToInt64(double v) {
+    return v >= -9223372036854775808.0 && v < 9223372036854775808.0 ? (int64_t)v : INT64_MIN;
+}
+
+// String, array and sample literals of one program. A formula refers to a literal by a handle:
+// its position in the table plus HANDLE_TAG, so handles are uncapped and every kind is read the
+// same way. Strings and arrays are copied into one contiguous arena, arrays in the narrowest
+// type that holds their values exactly; samples stay shared with the asset table.
+class LiteralArena {
+public:
+    enum class Kind : uint8_t { Bytes, Int32, Float64 };
+
+    // Handles sit above any t (2^32), so neither t, small arithmetic results nor an unassigned
+    // variable (0) reads some literal by accident; Load and Length treat them as missing
+    static constexpr double HANDLE_TAG = 1099511627776.0; // 2^40
+    static double Handle(int id) { return HANDLE_TAG + id; }
+
+    int AddBytes(std::string_view bytes);
+    int AddArray(const std::vector<double>& values);
+    int AddSample(SampleData data);
+    // Appends literal id of another arena, e.g. when instructions move between programs
+    int Copy(const LiteralArena& from, int id);
+
+    size_t Count() const { return m_table.size(); }
+    // Drops literals from index count on, after a failed compile
+    void Truncate(size_t count);
+    void Clear();
+    size_t MemoryBytes() const;
+
+    // Element i of the literal behind handle as a number, 0 when either is out of range
+    double Load(double handle, double i) const {
+        int l = Find(handle), k = ToInt32(i);
+        if (l < 0) return 0.0;
+        const Literal& lit = m_table[l];
+        if (k < 0 || (uint32_t)k >= lit.length) return 0.0;
+        const uint8_t* p = lit.external ? lit.external : m_bytes.data() + lit.offset;
+        switch (lit.kind) {
+        case Kind::Bytes: return p[k];
+        case Kind::Int32: { int32_t v; memcpy(&v, p + k * 4, 4); return v; }
+        default: { double v; memcpy(&v, p + k * 8, 8); return v; }
+        }
+    }
+    // Load at i modulo the literal's length, what h[i % h.length] computes
+    double LoadWrapped(double handle, double i) const {
+        int l = Find(handle);
+        if (l < 0 || m_table[l].length == 0) return 0.0;
+        double length = m_table[l].length;
+        // Whole non-negative indices (t and most offsets) take the integer remainder, it equals fmod
+        if (i >= 0.0 && i < 9007199254740992.0 && i == (double)(uint64_t)i) return Load(handle, (double)((uint64_t)i % m_table[l].length));
+        return Load(handle, fmod(i, length));
+    }
+    double Length(double handle) const {
+        int l = Find(handle);
+        return l >= 0 ? (double)m_table[l].length : 0.0;
+    }
+
+private:
+    struct Literal {
+        Kind kind;
+        uint32_t length;                   // Elements
+        size_t offset;                     // Into m_bytes, unless external
+        const uint8_t* external = nullptr; // Sample bytes, kept alive by sample
+        SampleData sample;
+    };
+    int Append(Kind kind, const void* data, size_t length, size_t elementSize);
+    // Table index of handle, -1 for any other number
+    int Find(double handle) const {
+        double k = handle - HANDLE_TAG;
+        if (!(k >= 0.0 && k < (double)m_table.size()) || k != (double)(int)k) return -1;
+        return (int)k;
+    }
+
+    std::vector<Literal> m_table;
+    std::vector<uint8_t> m_bytes;
+};
+
+// Variables and literals shared by all instructions of one program
+struct BytebeatVM {
+    std::vector<double> memory;
+    std::map<std::string, int, std::less<>> varTable; // Looked up by string_view while lexing
+    LiteralArena literals;
+
+    // Reset VM state before compilation
+    void reset() {
+        memory.clear();
+        varTable.clear();
+        literals.Clear();
+    }
+
+    // Allocate index for variable
+    int getVarId(std::string_view name) {
+        auto it = varTable.find(name);
+        if (it != varTable.end()) return it->second;
+        int id = (int)memory.size();
+        varTable.emplace(name, id);
+        memory.push_back(0.0); // Init with 0
+        return id;
+    }
+};
+
+// Decodes the quoted literal starting at expr[i] (escapes and \xNN) into out.
+// Returns the index just past the closing quote, or expr.size() if it is unterminated.
+size_t ParseStringLiteral(std::string_view expr, size_t i, std::string& out);
+
+// Single expression. Not synchronized: ComplexEngine serializes Compile and Eval.
 class BytebeatExpression {
 public:
-    bool Compile(const std::string& expr, std::string& error, int& errorPos);
+    bool Compile(std::string_view expr, std::string& error, int& errorPos, BytebeatVM& vm);
     double Eval(uint32_t t) const;
+    void Bind(BytebeatVM& vm) { m_vm = &vm; }
+    // Copies this expression's literals from one VM's arena to the end of another's (samples are
+    // shared, not copied), rebinds its tokens to the new handles and binds to that VM
+    void Relocate(BytebeatVM& from, BytebeatVM& to);
+    size_t MemoryBytes() const { return m_rpn.capacity() * sizeof(Token); }
+
+    // What the value depends on, for hoisting: t or random(), assignments through '=' inside the
+    // expression, and the IDs of variables read (appended to ids)
+    bool UsesTime() const;
+    bool Assigns() const;
+    void Reads(std::vector<int>& ids) const;
 private:
+    void FuseWrappedLookups();
+
     std::vector<Token> m_rpn;
+    BytebeatVM* m_vm = nullptr;
 };
 
 class ComplexEngine {
@@ -40,9 +172,54 @@ public:
         Type type;
         int targetVarIdx = -1;
         BytebeatExpression expr;
+        std::string_view source; // Segment text in the engine's copy of the code, what Recompile matches on
+        bool invariant = false;  // Same value every sample: evaluated once into value, skipped by Eval
+        double value = 0.0;
     };
 
     std::vector<Instruction> instructions;
+    BytebeatVM vm;
+
+    ComplexEngine() = default;
+    // Instructions point at this engine's VM
+    ComplexEngine(const ComplexEngine&) = delete;
+    ComplexEngine& operator=(const ComplexEngine&) = delete;
+
     bool Compile(const std::string& code, std::string& err, int& errorPos);
     int Eval(uint32_t t);
+
+    // Incremental Compile for live edits: segments whose text is unchanged keep their compiled
+    // instruction, variable IDs and values carry over. On error the previous program stays.
+    bool Recompile(const std::string& code, std::string& err, int& errorPos);
+
+    // Exchanges programs (instructions and VM) with other, e.g. one compiled on a worker.
+    // Holds both locks only for the pointer swaps. keepVariables carries values over by name,
+    // except for variables the new program sets once up front.
+    void Swap(ComplexEngine& other, bool keepVariables = false);
+
+    // Code of the current program, empty when the last Compile failed
+    const std::string& Source() const;
+    // Zeroes all variables, as if the program had just been compiled
+    void ResetVariables();
+    // Rough footprint of the program: tokens, segment texts and literal tables (not shared assets)
+    size_t MemoryBytes();
+
+private:
+    struct Segment {
+        std::string_view text;
+        size_t offset;
+    };
+    static std::vector<Segment> Split(std::string_view code);
+    bool CompileSegment(const Segment& seg, Instruction& ins, std::string& err, int& errorPos, BytebeatVM& target);
+    bool CompileAll(const std::string& code, std::string& err, int& errorPos);
+    // Loop-invariant instructions: MarkInvariants finds them after a compile, RunInvariants
+    // (re)establishes their values whenever variables were reset or overwritten
+    void MarkInvariants();
+    void RunInvariants();
+
+    // The only copy of the program text; instruction sources are views into it. Held by pointer
+    // so the views stay valid when engines are swapped.
+    std::unique_ptr<const std::string> m_source;
+    bool m_compiled = false;
+    std::mutex m_mutex; // Per engine: the audio callback evaluates while the UI recompiles
 };
\ No newline at end of file
@@ -0,0 +1,73 @@
+﻿#pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+// History of played output, one entry per formula t.
+// Single producer (audio callback); any number of readers copy recent history
+// without locking and without touching the engine. Readers that get lapped by
+// the producer during a copy see Read() fail and simply retry next frame.
+class CaptureRing {
+public:
+    static constexpr uint32_t CAPACITY = 1u << 18; // ~8 s at 32 kHz, power of two
+    static constexpr uint32_t MASK = CAPACITY - 1;
+    static constexpr uint32_t GUARD = 1024;        // Slots next to the write head readers never trust
+    static constexpr uint32_t HISTORY = CAPACITY - GUARD;
+
+    CaptureRing()
+        : m_values(new std::atomic<uint8_t>[CAPACITY]),
+          m_times(new std::atomic<uint32_t>[CAPACITY]) {
+        for (uint32_t i = 0; i < CAPACITY; i++) {
+            m_values[i].store(128, std::memory_order_relaxed);
+            m_times[i].store(0, std::memory_order_relaxed);
+        }
+    }
+
+    // Producer: records v for t unless t is the same sample as the previous call
+    // (the callback runs at 44.1 kHz while t advances at the formula rate)
+    void Capture(uint32_t t, uint8_t v) {
+        if (m_hasPrev && t == m_prevT) return;
+        m_hasPrev = true;
+        m_prevT = t;
+
+        uint64_t w = m_write.load(std::memory_order_relaxed);
+        m_values[w & MASK].store(v, std::memory_order_relaxed);
+        m_times[w & MASK].store(t, std::memory_order_relaxed);
+        m_write.store(w + 1, std::memory_order_release);
+    }
+
+    // Total samples ever captured; readable sequence numbers are [WriteCount() - HISTORY, WriteCount())
+    uint64_t WriteCount() const { return m_write.load(std::memory_order_acquire); }
+
+    // Copies samples [end - count, end) by sequence number. t (optional) receives their t values.
+    // Returns false if part of the range was never written or has been overwritten.
+    bool Read(uint64_t end, uint32_t count, uint8_t* out, uint32_t* t = nullptr) const {
+        uint64_t w = m_write.load(std::memory_order_acquire);
+        if (count > HISTORY || end > w || end < count || w - (end - count) > HISTORY) return false;
+
+        uint64_t start = end - count;
+        for (uint32_t i = 0; i < count; i++) {
+            uint64_t s = (start + i) & MASK;
+            out[i] = m_values[s].load(std::memory_order_relaxed);
+            if (t) t[i] = m_times[s].load(std::memory_order_relaxed);
+        }
+
+        // Producer may have lapped the oldest entries while we copied
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return m_write.load(std::memory_order_relaxed) - start <= HISTORY;
+    }
+
+    // Copies the newest count samples. Returns false if fewer are available.
+    bool ReadLatest(uint32_t count, uint8_t* out, uint32_t* t = nullptr) const {
+        return Read(WriteCount(), count, out, t);
+    }
+
+private:
+    std::unique_ptr<std::atomic<uint8_t>[]> m_values;
+    std::unique_ptr<std::atomic<uint32_t>[]> m_times;
+    std::atomic<uint64_t> m_write{ 0 };
+
+    // Producer-only
+    bool m_hasPrev = false;
+    uint32_t m_prevT = 0;
+};
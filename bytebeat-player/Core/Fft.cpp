@@ -0,0 +1,134 @@
+﻿#include "Fft.h"
+#include <cmath>
+#include <utility>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define FFT_SSE 1
+#endif
+
+using namespace std;
+
+static const double PI = 3.14159265358979323846;
+
+void ComplexFft::Resize(uint32_t size) {
+    m_size = size;
+    m_swaps.clear();
+    m_twRe.assign(size > 1 ? size - 1 : 0, 0.0f);
+    m_twIm.assign(size > 1 ? size - 1 : 0, 0.0f);
+
+    int bits = 0;
+    while ((1u << bits) < size) bits++;
+    for (uint32_t i = 0; i < size; i++) {
+        uint32_t r = 0;
+        for (int b = 0; b < bits; b++) r |= ((i >> b) & 1u) << (bits - 1 - b);
+        if (i < r) {
+            m_swaps.push_back(i);
+            m_swaps.push_back(r);
+        }
+    }
+
+    for (uint32_t h = 1; h < size; h <<= 1) {
+        for (uint32_t k = 0; k < h; k++) {
+            m_twRe[h - 1 + k] = (float)cos(PI * k / h);
+            m_twIm[h - 1 + k] = (float)-sin(PI * k / h);
+        }
+    }
+}
+
+void ComplexFft::Forward(float* re, float* im) const {
+    const uint32_t n = m_size;
+    for (size_t i = 0; i < m_swaps.size(); i += 2) {
+        swap(re[m_swaps[i]], re[m_swaps[i + 1]]);
+        swap(im[m_swaps[i]], im[m_swaps[i + 1]]);
+    }
+
+    // First two stages have trivial twiddles (1 and -i)
+    if (n >= 2) {
+        for (uint32_t a = 0; a < n; a += 2) {
+            float xr = re[a + 1], xi = im[a + 1];
+            re[a + 1] = re[a] - xr; im[a + 1] = im[a] - xi;
+            re[a] += xr; im[a] += xi;
+        }
+    }
+    if (n >= 4) {
+        for (uint32_t a = 0; a < n; a += 4) {
+            float xr = re[a + 2], xi = im[a + 2];
+            re[a + 2] = re[a] - xr; im[a + 2] = im[a] - xi;
+            re[a] += xr; im[a] += xi;
+
+            xr = im[a + 3]; xi = -re[a + 3];
+            re[a + 3] = re[a + 1] - xr; im[a + 3] = im[a + 1] - xi;
+            re[a + 1] += xr; im[a + 1] += xi;
+        }
+    }
+
+    // Remaining stages: four butterflies per step, twiddles are contiguous per stage
+    for (uint32_t h = 4; h < n; h <<= 1) {
+        const float* wr = &m_twRe[h - 1];
+        const float* wi = &m_twIm[h - 1];
+        for (uint32_t start = 0; start < n; start += 2 * h) {
+            float* ar = re + start; float* ai = im + start;
+            float* br = ar + h;     float* bi = ai + h;
+#ifdef FFT_SSE
+            for (uint32_t k = 0; k < h; k += 4) {
+                __m128 wR = _mm_loadu_ps(wr + k), wI = _mm_loadu_ps(wi + k);
+                __m128 bR = _mm_loadu_ps(br + k), bI = _mm_loadu_ps(bi + k);
+                __m128 xR = _mm_sub_ps(_mm_mul_ps(bR, wR), _mm_mul_ps(bI, wI));
+                __m128 xI = _mm_add_ps(_mm_mul_ps(bR, wI), _mm_mul_ps(bI, wR));
+                __m128 aR = _mm_loadu_ps(ar + k), aI = _mm_loadu_ps(ai + k);
+                _mm_storeu_ps(br + k, _mm_sub_ps(aR, xR));
+                _mm_storeu_ps(bi + k, _mm_sub_ps(aI, xI));
+                _mm_storeu_ps(ar + k, _mm_add_ps(aR, xR));
+                _mm_storeu_ps(ai + k, _mm_add_ps(aI, xI));
+            }
+#else
+            for (uint32_t k = 0; k < h; k++) {
+                float xr = br[k] * wr[k] - bi[k] * wi[k];
+                float xi = br[k] * wi[k] + bi[k] * wr[k];
+                br[k] = ar[k] - xr; bi[k] = ai[k] - xi;
+                ar[k] += xr; ai[k] += xi;
+            }
+#endif
+        }
+    }
+}
+
+void RealFft::Resize(uint32_t size) {
+    m_size = size;
+    uint32_t half = size / 2;
+    m_half.Resize(half);
+    m_zRe.assign(half, 0.0f);
+    m_zIm.assign(half, 0.0f);
+    m_twRe.resize(half);
+    m_twIm.resize(half);
+    for (uint32_t k = 0; k < half; k++) {
+        m_twRe[k] = (float)cos(2.0 * PI * k / size);
+        m_twIm[k] = (float)-sin(2.0 * PI * k / size);
+    }
+}
+
+void RealFft::Forward(const float* in, float* re, float* im) {
+    const uint32_t half = m_size / 2;
+
+    // Pack even/odd samples as one complex sequence
+    for (uint32_t i = 0; i < half; i++) {
+        m_zRe[i] = in[2 * i];
+        m_zIm[i] = in[2 * i + 1];
+    }
+    m_half.Forward(m_zRe.data(), m_zIm.data());
+
+    // Untangle: X[k] = E[k] + W^k O[k], with E and O recovered from Z[k] and conj(Z[half - k])
+    re[0] = m_zRe[0] + m_zIm[0]; im[0] = 0.0f;
+    re[half] = m_zRe[0] - m_zIm[0]; im[half] = 0.0f;
+    for (uint32_t k = 1; k < half; k++) {
+        float zr = m_zRe[k], zi = m_zIm[k];
+        float cr = m_zRe[half - k], ci = -m_zIm[half - k];
+
+        float er = 0.5f * (zr + cr), ei = 0.5f * (zi + ci);
+        float or_ = 0.5f * (zi - ci), oi = -0.5f * (zr - cr);
+
+        re[k] = er + or_ * m_twRe[k] - oi * m_twIm[k];
+        im[k] = ei + or_ * m_twIm[k] + oi * m_twRe[k];
+    }
+}
@@ -0,0 +1,36 @@
+﻿#pragma once
+#include <cstdint>
+#include <vector>
+
+// In-place radix-2 FFT over split real/imaginary arrays (forward, unscaled)
+class ComplexFft {
+public:
+    ComplexFft() = default;
+    explicit ComplexFft(uint32_t size) { Resize(size); }
+
+    void Resize(uint32_t size); // Power of two
+    uint32_t Size() const { return m_size; }
+    void Forward(float* re, float* im) const;
+
+private:
+    uint32_t m_size = 0;
+    std::vector<uint32_t> m_swaps;       // Bit-reversal pairs
+    std::vector<float> m_twRe, m_twIm;   // Stage with half-size h uses entries [h - 1, 2h - 1)
+};
+
+// FFT of size real samples through a size / 2 complex transform. Output is bins 0..size / 2.
+class RealFft {
+public:
+    RealFft() = default;
+    explicit RealFft(uint32_t size) { Resize(size); }
+
+    void Resize(uint32_t size); // Power of two >= 4
+    uint32_t Size() const { return m_size; }
+    void Forward(const float* in, float* re, float* im);
+
+private:
+    uint32_t m_size = 0;
+    ComplexFft m_half;
+    std::vector<float> m_zRe, m_zIm;
+    std::vector<float> m_twRe, m_twIm;   // exp(-2 pi i k / size), k < size / 2
+};
@@ -0,0 +1,534 @@
+﻿#define _CRT_SECURE_NO_WARNINGS
+#include "FlacEncoder.h"
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+using namespace std;
+
+static const int FLAC_BPS = 8;
+static const int MAX_LPC_ORDER = 32;
+static const int MAX_RICE_PARAM = 14;  // 15 is the escape code in 4-bit Rice mode
+static const int RICE_ESCAPE = 15;
+
+// --- Bit writer (MSB first, as FLAC expects) ---
+class BitWriter {
+public:
+    explicit BitWriter(vector<uint8_t>& out) : m_out(out) {}
+
+    void Write(uint32_t value, int bits) {
+        if (bits == 0) return;
+        uint64_t mask = (bits >= 32) ? 0xFFFFFFFFull : ((1ull << bits) - 1);
+        m_acc = (m_acc << bits) | (value & mask);
+        m_bits += bits;
+        while (m_bits >= 8) {
+            m_bits -= 8;
+            m_out.push_back((uint8_t)(m_acc >> m_bits));
+        }
+    }
+    void WriteSigned(int32_t value, int bits) { Write((uint32_t)value, bits); }
+    void WriteUnary(uint32_t zeros) {
+        while (zeros >= 32) {
+            Write(0, 32);
+            zeros -= 32;
+        }
+        Write(1, (int)zeros + 1);
+    }
+    void WriteRice(uint32_t folded, int k) {
+        WriteUnary(folded >> k);
+        Write(folded, k);
+    }
+    void AlignToByte() {
+        if (m_bits > 0) Write(0, 8 - m_bits);
+    }
+
+private:
+    vector<uint8_t>& m_out;
+    uint64_t m_acc = 0;
+    int m_bits = 0;
+};
+
+// --- Checksums ---
+static uint8_t Crc8(const uint8_t* data, size_t len) {
+    uint8_t crc = 0;
+    for (size_t i = 0; i < len; i++) {
+        crc ^= data[i];
+        for (int b = 0; b < 8; b++) crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x07) : (uint8_t)(crc << 1);
+    }
+    return crc;
+}
+
+static uint16_t Crc16(const uint8_t* data, size_t len) {
+    uint16_t crc = 0;
+    for (size_t i = 0; i < len; i++) {
+        crc ^= (uint16_t)(data[i] << 8);
+        for (int b = 0; b < 8; b++) crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x8005) : (uint16_t)(crc << 1);
+    }
+    return crc;
+}
+
+// --- Residual coding ---
+static inline uint32_t Fold(int32_t r) {
+    return ((uint32_t)r << 1) ^ (uint32_t)(r >> 31);
+}
+
+static int SignedBitsNeeded(int32_t v) {
+    // Two's complement width of v, including the sign bit
+    uint32_t u = (v < 0) ? (uint32_t)~v : (uint32_t)v;
+    int bits = 1;
+    while (u) {
+        bits++;
+        u >>= 1;
+    }
+    return bits;
+}
+
+struct RicePlan {
+    int order = 0;
+    vector<int> params;   // RICE_ESCAPE marks an escaped (raw) partition
+    vector<int> rawBits;
+    uint64_t bits = UINT64_MAX;
+};
+
+// Picks the partition order and per-partition Rice parameters for residual[0..n-predOrder)
+static RicePlan PlanResidual(const int32_t* residual, int blockSize, int predOrder, int maxPartOrder) {
+    RicePlan best;
+
+    // Limit partition order: block must divide evenly and partitions must hold the warm-up
+    int maxOrder = 0;
+    while (maxOrder < maxPartOrder &&
+        (blockSize % (1 << (maxOrder + 1))) == 0 &&
+        (blockSize >> (maxOrder + 1)) > predOrder)
+        maxOrder++;
+
+    // Per-sample folded values and widths at the finest partitioning, merged upwards
+    int parts = 1 << maxOrder;
+    vector<uint64_t> sums(parts, 0);
+    vector<int> widths(parts, 0);
+    {
+        int partSize = blockSize >> maxOrder;
+        int idx = 0;
+        for (int p = 0; p < parts; p++) {
+            int n = (p == 0) ? partSize - predOrder : partSize;
+            uint64_t s = 0;
+            int w = 0;
+            for (int i = 0; i < n; i++, idx++) {
+                s += Fold(residual[idx]);
+                if (residual[idx] != 0) w = max(w, SignedBitsNeeded(residual[idx]));
+            }
+            sums[p] = s;
+            widths[p] = w;
+        }
+    }
+
+    for (int order = maxOrder; order >= 0; order--) {
+        int partCount = 1 << order;
+        int partSize = blockSize >> order;
+        RicePlan plan;
+        plan.order = order;
+        plan.params.resize(partCount);
+        plan.rawBits.resize(partCount, 0);
+        uint64_t total = 2 + 4; // coding method + partition order
+
+        for (int p = 0; p < partCount; p++) {
+            uint64_t n = (p == 0) ? (uint64_t)(partSize - predOrder) : (uint64_t)partSize;
+            uint64_t s = sums[p];
+
+            int bestK = 0;
+            uint64_t bestCost = UINT64_MAX;
+            for (int k = 0; k <= MAX_RICE_PARAM; k++) {
+                uint64_t cost = n * (uint64_t)(k + 1) + (s >> k);
+                if (cost < bestCost) {
+                    bestCost = cost;
+                    bestK = k;
+                }
+            }
+            // Escaped partitions cost 5 bits + fixed width; all-zero runs collapse to width 0
+            uint64_t escCost = 5 + n * (uint64_t)widths[p];
+            if (escCost < bestCost) {
+                plan.params[p] = RICE_ESCAPE;
+                plan.rawBits[p] = widths[p];
+                bestCost = escCost;
+            }
+            else plan.params[p] = bestK;
+            total += 4 + bestCost;
+        }
+        plan.bits = total;
+        if (plan.bits < best.bits) best = plan;
+
+        // Merge neighbouring partitions for the next coarser order
+        if (order > 0) {
+            for (int p = 0; p < partCount / 2; p++) {
+                sums[p] = sums[2 * p] + sums[2 * p + 1];
+                widths[p] = max(widths[2 * p], widths[2 * p + 1]);
+            }
+        }
+    }
+    return best;
+}
+
+static void WriteResidual(BitWriter& bw, const int32_t* residual, int blockSize, int predOrder, const RicePlan& plan) {
+    bw.Write(0, 2); // Partitioned Rice, 4-bit parameters
+    bw.Write((uint32_t)plan.order, 4);
+
+    int partCount = 1 << plan.order;
+    int partSize = blockSize >> plan.order;
+    int idx = 0;
+    for (int p = 0; p < partCount; p++) {
+        int n = (p == 0) ? partSize - predOrder : partSize;
+        int k = plan.params[p];
+        bw.Write((uint32_t)k, 4);
+        if (k == RICE_ESCAPE) {
+            int w = plan.rawBits[p];
+            bw.Write((uint32_t)w, 5);
+            for (int i = 0; i < n; i++, idx++) bw.WriteSigned(residual[idx], w);
+        }
+        else {
+            for (int i = 0; i < n; i++, idx++) bw.WriteRice(Fold(residual[idx]), k);
+        }
+    }
+}
+
+// --- Predictors ---
+static void FixedResidual(const int32_t* x, int n, int order, int32_t* res) {
+    for (int i = order; i < n; i++) {
+        int32_t r = 0;
+        switch (order) {
+        case 0: r = x[i]; break;
+        case 1: r = x[i] - x[i - 1]; break;
+        case 2: r = x[i] - 2 * x[i - 1] + x[i - 2]; break;
+        case 3: r = x[i] - 3 * x[i - 1] + 3 * x[i - 2] - x[i - 3]; break;
+        case 4: r = x[i] - 4 * x[i - 1] + 6 * x[i - 2] - 4 * x[i - 3] + x[i - 4]; break;
+        }
+        res[i - order] = r;
+    }
+}
+
+static void LpcResidual(const int32_t* x, int n, const int32_t* qlp, int order, int shift, int32_t* res) {
+    for (int i = order; i < n; i++) {
+        int64_t sum = 0;
+        for (int j = 0; j < order; j++) sum += (int64_t)qlp[j] * x[i - j - 1];
+        res[i - order] = x[i] - (int32_t)(sum >> shift);
+    }
+}
+
+// Levinson-Durbin recursion; lp[o][..] holds predictor coefficients for order o+1
+static int ComputeLpc(const double* autoc, int maxOrder, double lp[][MAX_LPC_ORDER], double* err) {
+    double lpc[MAX_LPC_ORDER];
+    double e = autoc[0];
+    for (int i = 0; i < maxOrder; i++) {
+        double r = -autoc[i + 1];
+        for (int j = 0; j < i; j++) r -= lpc[j] * autoc[i - j];
+        r /= e;
+
+        lpc[i] = r;
+        int j = 0;
+        for (; j < (i >> 1); j++) {
+            double tmp = lpc[j];
+            lpc[j] += r * lpc[i - 1 - j];
+            lpc[i - 1 - j] += r * tmp;
+        }
+        if (i & 1) lpc[j] += lpc[j] * r;
+
+        e *= (1.0 - r * r);
+        for (j = 0; j <= i; j++) lp[i][j] = -lpc[j];
+        err[i] = e;
+        if (e <= 0.0) return i + 1;
+    }
+    return maxOrder;
+}
+
+static bool QuantizeLpc(const double* lp, int order, int precision, int32_t* qlp, int& shift) {
+    double cmax = 0.0;
+    for (int i = 0; i < order; i++) cmax = max(cmax, fabs(lp[i]));
+    if (cmax <= 0.0) return false;
+
+    int bits = precision - 1; // Sign bit
+    int32_t qmax = (1 << bits) - 1;
+    int32_t qmin = -(1 << bits);
+
+    int log2cmax;
+    frexp(cmax, &log2cmax);
+    shift = bits - log2cmax;
+    if (shift > 15) shift = 15;
+    if (shift < 0) return false; // Negative shifts are not allowed by the format
+
+    double error = 0.0;
+    for (int i = 0; i < order; i++) {
+        error += lp[i] * (double)(1 << shift);
+        long q = lround(error);
+        if (q > qmax) q = qmax;
+        else if (q < qmin) q = qmin;
+        error -= (double)q;
+        qlp[i] = (int32_t)q;
+    }
+    return true;
+}
+
+// --- Frame encoding ---
+struct StreamParams {
+    int sampleRate;
+    int blockSize;
+    const FlacEncoderOptions* opt;
+};
+
+static void WriteUtf8Number(BitWriter& bw, uint64_t v) {
+    if (v < 0x80) {
+        bw.Write((uint32_t)v, 8);
+        return;
+    }
+    int extra = (v < 0x800) ? 1 : (v < 0x10000) ? 2 : (v < 0x200000) ? 3 :
+        (v < 0x4000000) ? 4 : (v < 0x80000000ull) ? 5 : 6;
+    uint32_t lead = (0xFF00u >> (extra + 1)) & 0xFF;
+    bw.Write(lead | (uint32_t)(v >> (6 * extra)), 8);
+    for (int i = extra - 1; i >= 0; i--) bw.Write(0x80 | (uint32_t)((v >> (6 * i)) & 0x3F), 8);
+}
+
+static int SampleRateCode(int rate) {
+    switch (rate) {
+    case 88200: return 1;
+    case 176400: return 2;
+    case 192000: return 3;
+    case 8000: return 4;
+    case 16000: return 5;
+    case 22050: return 6;
+    case 24000: return 7;
+    case 32000: return 8;
+    case 44100: return 9;
+    case 48000: return 10;
+    case 96000: return 11;
+    default: return (rate > 0 && rate < 65536) ? 13 : 0; // 13 = 16-bit Hz follows, 0 = see STREAMINFO
+    }
+}
+
+static int BlockSizeCode(int n) {
+    switch (n) {
+    case 192: return 1;
+    case 576: return 2;
+    case 1152: return 3;
+    case 2304: return 4;
+    case 4608: return 5;
+    }
+    for (int code = 8; code <= 15; code++) {
+        if (n == (256 << (code - 8))) return code;
+    }
+    return (n <= 256) ? 6 : 7; // 6/7 = explicit 8/16-bit size follows
+}
+
+static void EncodeFrame(const int32_t* x, int n, uint64_t frameIndex, const StreamParams& sp, vector<uint8_t>& out) {
+    const FlacEncoderOptions& opt = *sp.opt;
+    BitWriter bw(out);
+
+    // Header
+    int bsCode = BlockSizeCode(n);
+    int srCode = SampleRateCode(sp.sampleRate);
+
+    bw.Write(0x3FFE, 14); // Sync
+    bw.Write(0, 1);
+    bw.Write(0, 1);       // Fixed block size stream
+    bw.Write((uint32_t)bsCode, 4);
+    bw.Write((uint32_t)srCode, 4);
+    bw.Write(0, 4);       // Mono
+    bw.Write(1, 3);       // 8 bits per sample
+    bw.Write(0, 1);
+    WriteUtf8Number(bw, frameIndex);
+    if (bsCode == 6) bw.Write((uint32_t)(n - 1), 8);
+    else if (bsCode == 7) bw.Write((uint32_t)(n - 1), 16);
+    if (srCode == 13) bw.Write((uint32_t)sp.sampleRate, 16);
+    bw.Write(Crc8(out.data(), out.size()), 8);
+
+    // Subframe header: zero pad + type + no wasted bits
+    bool constant = all_of(x, x + n, [&](int32_t v) { return v == x[0]; });
+    if (constant) {
+        bw.Write(0, 1);
+        bw.Write(0, 6);
+        bw.Write(0, 1);
+        bw.WriteSigned(x[0], FLAC_BPS);
+    }
+    else {
+        vector<int32_t> residual(n), bestResidual(n);
+        RicePlan bestPlan;
+        int bestType = -1;   // 0..4 FIXED, 32+ LPC order
+        uint64_t bestBits = (uint64_t)n * FLAC_BPS; // VERBATIM
+        int32_t bestQlp[MAX_LPC_ORDER];
+        int bestShift = 0;
+
+        auto consider = [&](int type, int order, uint64_t headerBits) {
+            RicePlan plan = PlanResidual(residual.data(), n, order, opt.maxPartitionOrder);
+            uint64_t bits = headerBits + plan.bits;
+            if (bits < bestBits) {
+                bestBits = bits;
+                bestType = type;
+                bestPlan = plan;
+                swap(residual, bestResidual);
+                return true;
+            }
+            return false;
+        };
+
+        for (int order = 0; order <= 4 && order < n; order++) {
+            FixedResidual(x, n, order, residual.data());
+            consider(order, order, (uint64_t)order * FLAC_BPS);
+        }
+
+        int maxOrder = min(min(opt.maxLpcOrder, MAX_LPC_ORDER), n - 1);
+        if (maxOrder > 0) {
+            // Tukey(0.5) window before autocorrelation
+            vector<double> w(n);
+            int taper = n / 4;
+            for (int i = 0; i < n; i++) {
+                double g = 1.0;
+                if (taper > 0 && i < taper) g = 0.5 - 0.5 * cos(3.14159265358979323846 * i / taper);
+                else if (taper > 0 && i >= n - taper) g = 0.5 - 0.5 * cos(3.14159265358979323846 * (n - 1 - i) / taper);
+                w[i] = x[i] * g;
+            }
+            double autoc[MAX_LPC_ORDER + 1];
+            for (int lag = 0; lag <= maxOrder; lag++) {
+                double s = 0.0;
+                for (int i = lag; i < n; i++) s += w[i] * w[i - lag];
+                autoc[lag] = s;
+            }
+
+            if (autoc[0] > 0.0) {
+                double lp[MAX_LPC_ORDER][MAX_LPC_ORDER];
+                double err[MAX_LPC_ORDER];
+                int orders = ComputeLpc(autoc, maxOrder, lp, err);
+
+                // Estimate the best order from the prediction error instead of trying them all
+                int estOrder = 1;
+                double estBits = 1e300;
+                for (int o = 1; o <= orders; o++) {
+                    double perSample = (err[o - 1] > 0.0) ? max(0.0, 0.5 * log2(err[o - 1] / n)) : 0.0;
+                    double bits = perSample * (n - o) + o * (opt.lpcPrecision + FLAC_BPS);
+                    if (bits < estBits) {
+                        estBits = bits;
+                        estOrder = o;
+                    }
+                }
+
+                int32_t qlp[MAX_LPC_ORDER];
+                int shift = 0;
+                if (QuantizeLpc(lp[estOrder - 1], estOrder, opt.lpcPrecision, qlp, shift)) {
+                    LpcResidual(x, n, qlp, estOrder, shift, residual.data());
+                    uint64_t header = (uint64_t)estOrder * FLAC_BPS + 4 + 5 + (uint64_t)estOrder * opt.lpcPrecision;
+                    if (consider(32 + estOrder, estOrder, header)) {
+                        copy(qlp, qlp + estOrder, bestQlp);
+                        bestShift = shift;
+                    }
+                }
+            }
+        }
+
+        bw.Write(0, 1);
+        if (bestType < 0) {
+            bw.Write(1, 6); // VERBATIM
+            bw.Write(0, 1);
+            for (int i = 0; i < n; i++) bw.WriteSigned(x[i], FLAC_BPS);
+        }
+        else if (bestType < 32) {
+            int order = bestType;
+            bw.Write(8 | (uint32_t)order, 6); // FIXED
+            bw.Write(0, 1);
+            for (int i = 0; i < order; i++) bw.WriteSigned(x[i], FLAC_BPS);
+            WriteResidual(bw, bestResidual.data(), n, order, bestPlan);
+        }
+        else {
+            int order = bestType - 32;
+            bw.Write(32 | (uint32_t)(order - 1), 6); // LPC
+            bw.Write(0, 1);
+            for (int i = 0; i < order; i++) bw.WriteSigned(x[i], FLAC_BPS);
+            bw.Write((uint32_t)(opt.lpcPrecision - 1), 4);
+            bw.WriteSigned(bestShift, 5);
+            for (int i = 0; i < order; i++) bw.WriteSigned(bestQlp[i], opt.lpcPrecision);
+            WriteResidual(bw, bestResidual.data(), n, order, bestPlan);
+        }
+    }
+
+    // Footer
+    bw.AlignToByte();
+    uint16_t crc = Crc16(out.data(), out.size());
+    bw.Write(crc, 16);
+}
+
+bool EncodeFlac(const uint8_t* samples, size_t count, int sampleRate, vector<uint8_t>& out, const FlacEncoderOptions& opt) {
+    out.clear();
+    if (opt.blockSize < 16 || opt.blockSize > 65535) return false;
+    if (sampleRate <= 0 || sampleRate > 655350) return false;
+    if (count >= (1ull << 36)) return false;
+
+    FlacEncoderOptions o = opt;
+    o.lpcPrecision = max(2, min(o.lpcPrecision, 15));
+    o.maxPartitionOrder = max(0, min(o.maxPartitionOrder, 15));
+
+    StreamParams sp;
+    sp.sampleRate = sampleRate;
+    sp.blockSize = o.blockSize;
+    sp.opt = &o;
+
+    size_t frameCount = (count + o.blockSize - 1) / o.blockSize;
+    vector<vector<uint8_t>> frames(frameCount);
+
+    // Frames share nothing, so workers just pull the next index
+    atomic<size_t> next(0);
+    auto worker = [&]() {
+        vector<int32_t> x(o.blockSize);
+        for (size_t f = next++; f < frameCount; f = next++) {
+            size_t start = f * o.blockSize;
+            int n = (int)min((size_t)o.blockSize, count - start);
+            for (int i = 0; i < n; i++) x[i] = (int32_t)samples[start + i] - 128;
+            EncodeFrame(x.data(), n, f, sp, frames[f]);
+        }
+    };
+
+    unsigned threadCount = (o.threads > 0) ? (unsigned)o.threads : thread::hardware_concurrency();
+    if (threadCount == 0) threadCount = 1;
+    threadCount = (unsigned)min((size_t)threadCount, max((size_t)1, frameCount));
+
+    vector<thread> pool;
+    for (unsigned i = 1; i < threadCount; i++) pool.emplace_back(worker);
+    worker();
+    for (auto& th : pool) th.join();
+
+    size_t minFrame = SIZE_MAX, maxFrame = 0, total = 0;
+    for (const auto& fr : frames) {
+        minFrame = min(minFrame, fr.size());
+        maxFrame = max(maxFrame, fr.size());
+        total += fr.size();
+    }
+    if (frames.empty()) minFrame = 0;
+
+    // Stream marker + STREAMINFO (MD5 left unset)
+    out.reserve(4 + 4 + 34 + total);
+    BitWriter bw(out);
+    bw.Write('f', 8); bw.Write('L', 8); bw.Write('a', 8); bw.Write('C', 8);
+    bw.Write(1, 1);  // Last metadata block
+    bw.Write(0, 7);  // STREAMINFO
+    bw.Write(34, 24);
+    bw.Write((uint32_t)o.blockSize, 16);
+    bw.Write((uint32_t)o.blockSize, 16);
+    bw.Write((uint32_t)min(minFrame, (size_t)0xFFFFFF), 24);
+    bw.Write((uint32_t)min(maxFrame, (size_t)0xFFFFFF), 24);
+    bw.Write((uint32_t)sampleRate, 20);
+    bw.Write(0, 3);               // Channels - 1
+    bw.Write(FLAC_BPS - 1, 5);
+    bw.Write((uint32_t)((uint64_t)count >> 32), 4);
+    bw.Write((uint32_t)count, 32);
+    for (int i = 0; i < 4; i++) bw.Write(0, 32);
+
+    for (const auto& fr : frames) out.insert(out.end(), fr.begin(), fr.end());
+    return true;
+}
+
+bool WriteFlacFile(const string& path, const uint8_t* samples, size_t count, int sampleRate, const FlacEncoderOptions& opt) {
+    vector<uint8_t> data;
+    if (!EncodeFlac(samples, count, sampleRate, data, opt)) return false;
+
+    FILE* f = fopen(path.c_str(), "wb");
+    if (!f) return false;
+    size_t written = fwrite(data.data(), 1, data.size(), f);
+    fclose(f);
+    return written == data.size();
+}
@@ -0,0 +1,21 @@
+﻿#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+struct FlacEncoderOptions {
+    int blockSize = 4096;   // Samples per frame (16..65535)
+    int maxLpcOrder = 12;   // 0 disables LPC and leaves only FIXED predictors
+    int lpcPrecision = 12;  // Quantized coefficient precision in bits
+    int maxPartitionOrder = 8;
+    int threads = 0;        // 0 = hardware concurrency
+};
+
+// Encodes unsigned 8-bit mono PCM (bytebeat output) into a complete FLAC stream.
+// Frames are independent, so they are encoded in parallel and concatenated in order.
+bool EncodeFlac(const uint8_t* samples, size_t count, int sampleRate,
+    std::vector<uint8_t>& out, const FlacEncoderOptions& opt = FlacEncoderOptions());
+
+bool WriteFlacFile(const std::string& path, const uint8_t* samples, size_t count, int sampleRate,
+    const FlacEncoderOptions& opt = FlacEncoderOptions());
@@ -1,47 +1,22 @@
 ﻿#pragma once
+#include "BackgroundCompiler.h"
 #include "Bytebeat.h"
+#include "CaptureRing.h"
+#include "Overview.h"
+#include "Presets.h"
+#include "Spectrum.h"
 #include "TextEditor.h"
+#include "Trigger.h"
+#include "WavImport.h"
 #include <string>
 #include <vector>
-#include <map>
-
-struct BytebeatPreset {
-    std::string title;
-    std::string code;
-    int sampleRate;
-
-    BytebeatPreset() : title(""), code(""), sampleRate(8000) {}
-};
 
 extern std::vector<BytebeatPreset> g_presets;
 
 struct AppState {
     // Logic
     ComplexEngine engine;
-
-    // Quick access
-    std::vector<double> vmMemory;
-    std::map<std::string, int> varTable;
-
-    // Helper: Reset VM state before compilation
-    void resetVM() {
-        vmMemory.clear();
-        varTable.clear();
-    }
-
-    std::map<std::string, std::string> hiddenChunks;
-    int hiddenCounter = 0;
-
-    // Allocate index for variable
-    int getVarId(const std::string& name) {
-        if (varTable.find(name) == varTable.end()) {
-            int id = (int)vmMemory.size();
-            varTable[name] = id;
-            vmMemory.push_back(0.0); // Init with 0
-            return id;
-        }
-        return varTable[name];
-    }
+    BackgroundCompiler compiler;
 
     TextEditor editor;
     bool playing = false;
@@ -49,13 +24,14 @@ struct AppState {
     char inputBuf[2048];
     std::string errorMsg;
     int errorPos = -1;
+    std::string compiledCode; // Last program that compiled, may reference @chunk(N) and @sample(N)
 
     // Audio
     uint32_t t = 0;
     double tAccum = 0.0;
     float volume = 1.0f;
-    float scope[256] = { 0 };
-    int scopeIdx = 0;
+    CaptureRing capture; // Played samples for the scope and other visualizers
+    SpectrumAnalyzer spectrum;
 
     // Settings
     const int rates[7] = { 8000, 11025, 16000, 22050, 32000, 44100, 48000 };
@@ -65,10 +41,17 @@ struct AppState {
     // View/Export
     float zoomFactors[4] = { 1.0f, 2.0f, 4.0f, 8.0f };
     int zoomIdx = 0;
+    TriggerEngine trigger;
+    WaveformOverview overview;
+    int overviewMinutes = 60;
     float exportProgress = -1.0f;
     float successMsgTimer = 0.0f;
     std::string fileName = "";
+    WavImporter importer;
+    std::string importError;
+    float importErrorTimer = 0.0f;
     int exportDuration = 30;
+    int exportFormat = 0; // 0 = WAV, 1 = FLAC
     char exportFilenameBuf[128] = { 0 };
 
     AppState(); // Constructor
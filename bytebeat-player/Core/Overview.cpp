@@ -0,0 +1,176 @@
+﻿#include "Overview.h"
+#include "Bytebeat.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+using namespace std;
+
+void WaveformOverview::Start(const string& code, int sampleRate, uint64_t length) {
+    Stop();
+    m_code = code;
+    m_rate = sampleRate;
+    m_length = max<uint64_t>(length, 1);
+    m_rendered.store(0, memory_order_relaxed);
+
+    // Coarsen the finest level until it fits MAX_BLOCKS
+    m_blockLog2 = MIN_BLOCK_LOG2;
+    while (((m_length - 1) >> m_blockLog2) + 1 > MAX_BLOCKS) m_blockLog2++;
+
+    m_min.clear();
+    m_max.clear();
+    uint64_t entries = ((m_length - 1) >> m_blockLog2) + 1;
+    for (;;) {
+        m_min.emplace_back(entries, 255);
+        m_max.emplace_back(entries, 0);
+        if (entries == 1) break;
+        entries = (entries + 1) / 2;
+    }
+
+    {
+        lock_guard<mutex> lock(m_detailMutex);
+        m_detailWanted = false;
+        m_detail.clear();
+    }
+
+    m_running = true;
+    m_thread = thread(&WaveformOverview::Run, this);
+}
+
+void WaveformOverview::Stop() {
+    m_running = false;
+    if (m_thread.joinable()) m_thread.join();
+}
+
+bool WaveformOverview::Finalized(int level, uint64_t entry) const {
+    uint64_t rendered = Rendered();
+    return rendered >= m_length || ((entry + 1) << (m_blockLog2 + level)) <= rendered;
+}
+
+void WaveformOverview::Run() {
+    string err;
+    int errorPos = -1;
+    ComplexEngine engine, detailEngine;
+    if (!engine.Compile(m_code, err, errorPos) || !detailEngine.Compile(m_code, err, errorPos)) return;
+
+    const uint64_t block = 1ull << m_blockLog2;
+    const uint64_t blocks = m_min[0].size();
+    const int levels = (int)m_min.size();
+    uint64_t sinceDetail = 0;
+
+    for (uint64_t b = 0; m_running; ) {
+        // Deep-zoom requests are served between blocks so they stay responsive during the render
+        if (sinceDetail >= DETAIL || b == blocks) {
+            sinceDetail = 0;
+            uint64_t want = 0;
+            bool wanted;
+            {
+                lock_guard<mutex> lock(m_detailMutex);
+                wanted = m_detailWanted;
+                want = m_detailWant;
+            }
+            if (wanted) {
+                uint32_t count = (uint32_t)min<uint64_t>(DETAIL, m_length - want);
+                vector<uint8_t> samples(count);
+                for (uint32_t i = 0; i < count; i++) samples[i] = (uint8_t)(detailEngine.Eval((uint32_t)(want + i)) & 0xFF);
+
+                lock_guard<mutex> lock(m_detailMutex);
+                m_detailStart = want;
+                m_detail.swap(samples);
+                if (m_detailWant == want) m_detailWanted = false;
+            }
+            else if (b == blocks) this_thread::sleep_for(chrono::milliseconds(5));
+        }
+        if (b == blocks) continue;
+
+        uint64_t start = b << m_blockLog2;
+        uint64_t end = min(start + block, m_length);
+        uint8_t lo = 255, hi = 0;
+        for (uint64_t t = start; t < end; t++) {
+            uint8_t v = (uint8_t)(engine.Eval((uint32_t)t) & 0xFF);
+            lo = min(lo, v);
+            hi = max(hi, v);
+        }
+        m_min[0][b] = lo;
+        m_max[0][b] = hi;
+        sinceDetail += end - start;
+
+        // A parent is complete once its last child is (or the song ends)
+        for (int l = 1; l < levels; l++) {
+            uint64_t mask = (1ull << l) - 1;
+            if ((b & mask) != mask && b + 1 != blocks) break;
+            uint64_t e = b >> l;
+            size_t c0 = (size_t)(2 * e), c1 = min(c0 + 1, m_min[l - 1].size() - 1);
+            m_min[l][e] = min(m_min[l - 1][c0], m_min[l - 1][c1]);
+            m_max[l][e] = max(m_max[l - 1][c0], m_max[l - 1][c1]);
+        }
+
+        b++;
+        m_rendered.store(min(b << m_blockLog2, m_length), memory_order_release);
+    }
+}
+
+void WaveformOverview::Query(double t0, double t1, int columns, uint8_t* mins, uint8_t* maxs) {
+    for (int c = 0; c < columns; c++) {
+        mins[c] = 255;
+        maxs[c] = 0;
+    }
+    if (m_min.empty() || t1 <= t0) return;
+
+    double spc = (t1 - t0) / columns;
+    const int levels = (int)m_min.size();
+
+    // Deep zoom: raw samples if the worker has them, otherwise ask and show the finest level meanwhile
+    if (spc < (double)(1ull << m_blockLog2)) {
+        uint64_t first = (uint64_t)max(0.0, floor(t0));
+        uint64_t last = (uint64_t)max(0.0, min(ceil(t1), (double)m_length));
+        lock_guard<mutex> lock(m_detailMutex);
+        if (!m_detail.empty() && first >= m_detailStart && last <= m_detailStart + m_detail.size()) {
+            for (int c = 0; c < columns; c++) {
+                double a = t0 + c * spc;
+                if (a < 0.0 || a >= (double)m_length) continue;
+                uint64_t i0 = (uint64_t)a;
+                uint64_t i1 = max(i0 + 1, min((uint64_t)(a + spc), last));
+                uint8_t lo = 255, hi = 0;
+                for (uint64_t i = i0; i < i1; i++) {
+                    uint8_t v = m_detail[(size_t)(i - m_detailStart)];
+                    lo = min(lo, v);
+                    hi = max(hi, v);
+                }
+                mins[c] = lo;
+                maxs[c] = hi;
+            }
+            return;
+        }
+        uint64_t center = (first + last) / 2;
+        uint64_t want = center > DETAIL / 2 ? center - DETAIL / 2 : 0;
+        if (m_length > DETAIL) want = min(want, m_length - DETAIL);
+        else want = 0;
+        m_detailWant = want;
+        m_detailWanted = true;
+    }
+
+    int level = 0;
+    while (level + 1 < levels && (double)(1ull << (m_blockLog2 + level + 1)) <= spc) level++;
+    int shift = m_blockLog2 + level;
+    const vector<uint8_t>& lvMin = m_min[level];
+    const vector<uint8_t>& lvMax = m_max[level];
+
+    for (int c = 0; c < columns; c++) {
+        double a = t0 + c * spc;
+        double b = a + spc;
+        if (b <= 0.0 || a >= (double)m_length) continue;
+        uint64_t e0 = (uint64_t)max(0.0, a) >> shift;
+        uint64_t e1 = ((uint64_t)max(1.0, min(b, (double)m_length)) - 1) >> shift;
+        e1 = max(e0, min<uint64_t>(e1, lvMin.size() - 1));
+        if (!Finalized(level, e1)) continue;
+
+        uint8_t lo = 255, hi = 0;
+        for (uint64_t e = e0; e <= e1; e++) {
+            lo = min(lo, lvMin[(size_t)e]);
+            hi = max(hi, lvMax[(size_t)e]);
+        }
+        mins[c] = lo;
+        maxs[c] = hi;
+    }
+}
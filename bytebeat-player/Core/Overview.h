@@ -0,0 +1,53 @@
+﻿#pragma once
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Whole-song waveform summary: a pyramid of 8-bit min/max peaks rendered from t = 0 by a
+// background thread. Any view from a few samples to the full length is drawn in O(columns).
+class WaveformOverview {
+public:
+    static constexpr int MIN_BLOCK_LOG2 = 8;          // Finest summary: 256 samples per entry
+    static constexpr uint32_t MAX_BLOCKS = 1u << 20;  // Finest entries at any length (bounds memory to ~4 MB)
+    static constexpr uint32_t DETAIL = 1u << 16;      // Raw samples rendered around a deep zoom
+
+    ~WaveformOverview() { Stop(); }
+
+    // Restarts rendering length samples of code at t = 0
+    void Start(const std::string& code, int sampleRate, uint64_t length);
+    void Stop();
+
+    const std::string& Code() const { return m_code; }
+    int Rate() const { return m_rate; }
+    uint64_t Length() const { return m_length; }
+    uint64_t Rendered() const { return m_rendered.load(std::memory_order_acquire); }
+
+    // Min/max over each of columns equal slices of [t0, t1); columns not rendered yet get min > max.
+    // Views finer than one block use raw samples rendered on request.
+    void Query(double t0, double t1, int columns, uint8_t* mins, uint8_t* maxs);
+
+private:
+    void Run();
+    bool Finalized(int level, uint64_t entry) const;
+
+    std::string m_code;
+    int m_rate = 0;
+    uint64_t m_length = 0;
+
+    int m_blockLog2 = MIN_BLOCK_LOG2;
+    std::vector<std::vector<uint8_t>> m_min, m_max; // Per level, level L entries cover 2^(blockLog2 + L) samples
+
+    std::thread m_thread;
+    std::atomic<bool> m_running{ false };
+    std::atomic<uint64_t> m_rendered{ 0 };
+
+    // Raw window for deep zoom, filled by the worker
+    std::mutex m_detailMutex;
+    bool m_detailWanted = false;
+    uint64_t m_detailWant = 0;
+    uint64_t m_detailStart = 0;
+    std::vector<uint8_t> m_detail;
+};
@@ -0,0 +1,71 @@
+﻿#include "Presets.h"
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+
+using namespace std;
+
+// Helper function to remove white characters (CR, LF, Spaces)
+static string TrimRight(string s) {
+    s.erase(find_if(s.rbegin(), s.rend(), [](unsigned char ch) {
+        return !isspace(ch);
+        }).base(), s.end()
+    );
+    return s;
+}
+
+// Helper function to remove BOM (Byte Order Mark)
+static string RemoveBOM(string s) {
+    if (s.size() >= 3 && 
+        (unsigned char)s[0] == 0xEF && 
+        (unsigned char)s[1] == 0xBB && 
+        (unsigned char)s[2] == 0xBF) {
+        return s.substr(3);
+    }
+    return s;
+}
+
+bool ParsePresetFile(const string& path, BytebeatPreset& preset) {
+    ifstream file(path);
+    if (!file.is_open()) return false;
+
+    preset = BytebeatPreset();
+    string line;
+    string accumulatedCode;
+    bool readingCode = false;
+    bool firstLine = true;
+
+    while (getline(file, line)) {
+        // Remove trash from endline
+        line = TrimRight(line);
+
+        // BOM fix for first line
+        if (firstLine) {
+            line = RemoveBOM(line);
+            firstLine = false;
+        }
+
+        if (readingCode) {
+            accumulatedCode += line + "\n";
+            continue;
+        }
+        if (line.find("Code=") == 0) {
+            readingCode = true;
+            if (line.length() > 5) accumulatedCode += line.substr(5) + "\n";
+        }
+        else if (line.find("Title=") == 0) preset.title = line.substr(6);
+        else if (line.find("Rate=") == 0) {
+            try {
+                preset.sampleRate = stoi(line.substr(5));
+            }
+            catch (...) { 
+                preset.sampleRate = 8000; 
+            }
+        }
+    }
+
+    preset.code = accumulatedCode;
+    if (!preset.code.empty() && preset.code.back() == '\n') preset.code.pop_back();
+
+    return !preset.title.empty() && !preset.code.empty();
+}
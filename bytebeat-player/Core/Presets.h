@@ -0,0 +1,14 @@
+﻿#pragma once
+#include <string>
+
+struct BytebeatPreset {
+    std::string title;
+    std::string code;
+    int sampleRate;
+
+    BytebeatPreset() : title(""), code(""), sampleRate(8000) {}
+};
+
+// Parses a preset .txt file (Title=, Rate=, Code= followed by the formula).
+// Returns false if the file can't be opened or has no Title/Code.
+bool ParsePresetFile(const std::string& path, BytebeatPreset& preset);
@@ -0,0 +1,66 @@
+﻿#include "ProgramCache.h"
+
+using namespace std;
+
+unique_ptr<ComplexEngine> ProgramCache::Remove(list<Entry>::iterator it) {
+    m_index.erase(string_view(it->engine->Source()));
+    unique_ptr<ComplexEngine> engine = move(it->engine);
+    m_bytes -= it->bytes;
+    m_entries.erase(it);
+    return engine;
+}
+
+unique_ptr<ComplexEngine> ProgramCache::Take(const string& code) {
+    lock_guard<mutex> lock(m_mutex);
+    auto it = m_index.find(code);
+    if (it == m_index.end()) {
+        m_misses++;
+        return nullptr;
+    }
+    m_hits++;
+    return Remove(it->second);
+}
+
+unique_ptr<ComplexEngine> ProgramCache::TakeNewest() {
+    lock_guard<mutex> lock(m_mutex);
+    if (m_entries.empty()) return nullptr;
+    return Remove(m_entries.begin());
+}
+
+void ProgramCache::Put(unique_ptr<ComplexEngine> engine) {
+    if (!engine || engine->Source().empty()) return;
+    // Sized and reset outside the lock, the engine isn't shared yet
+    engine->ResetVariables();
+    size_t bytes = engine->MemoryBytes();
+    string_view code = engine->Source();
+
+    lock_guard<mutex> lock(m_mutex);
+    auto existing = m_index.find(code);
+    if (existing != m_index.end()) Remove(existing->second);
+    if (bytes > m_budget) return;
+
+    m_entries.push_front(Entry{ move(engine), bytes });
+    m_index[code] = m_entries.begin();
+    m_bytes += bytes;
+    while (m_bytes > m_budget) Remove(prev(m_entries.end()));
+}
+
+uint64_t ProgramCache::Hits() {
+    lock_guard<mutex> lock(m_mutex);
+    return m_hits;
+}
+
+uint64_t ProgramCache::Misses() {
+    lock_guard<mutex> lock(m_mutex);
+    return m_misses;
+}
+
+size_t ProgramCache::Count() {
+    lock_guard<mutex> lock(m_mutex);
+    return m_entries.size();
+}
+
+size_t ProgramCache::Bytes() {
+    lock_guard<mutex> lock(m_mutex);
+    return m_bytes;
+}
@@ -0,0 +1,47 @@
+﻿#pragma once
+#include "Bytebeat.h"
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+// Recently used compiled programs, keyed by their code, so switching back to a preset or undoing
+// an edit swaps a finished engine in instead of compiling again. The code is a complete key:
+// @chunk(N) and @sample(N) handles refer to immutable assets, and there are no compile options.
+// Least recently stored programs are dropped once the byte budget is exceeded.
+class ProgramCache {
+public:
+    static constexpr size_t DEFAULT_BUDGET = 64u << 20;
+
+    explicit ProgramCache(size_t budgetBytes = DEFAULT_BUDGET) : m_budget(budgetBytes) {}
+
+    // Removes and returns the program compiled from code, counting a hit or a miss
+    std::unique_ptr<ComplexEngine> Take(const std::string& code);
+    // Removes and returns the newest program regardless of code, e.g. as a Recompile base
+    std::unique_ptr<ComplexEngine> TakeNewest();
+    // Stores engine under its Source() with variables zeroed; engines without a program are dropped
+    void Put(std::unique_ptr<ComplexEngine> engine);
+
+    uint64_t Hits();
+    uint64_t Misses();
+    size_t Count();
+    size_t Bytes();
+
+private:
+    struct Entry {
+        std::unique_ptr<ComplexEngine> engine;
+        size_t bytes;
+    };
+    std::unique_ptr<ComplexEngine> Remove(std::list<Entry>::iterator it);
+
+    std::mutex m_mutex; // Guards everything below, the UI and the compile worker both use the cache
+    size_t m_budget;
+    size_t m_bytes = 0;
+    uint64_t m_hits = 0;
+    uint64_t m_misses = 0;
+    std::list<Entry> m_entries; // Newest first
+    std::unordered_map<std::string_view, std::list<Entry>::iterator> m_index; // Views of each engine's Source()
+};
@@ -0,0 +1,52 @@
+﻿#define _CRT_SECURE_NO_WARNINGS
+#include "Renderer.h"
+#include <cstdio>
+
+using namespace std;
+
+void RenderSamples(ComplexEngine& engine, int formulaRate, int outputRate, uint32_t count, uint8_t* out, float* progress) {
+    double tAccumLocal = 0.0;
+    uint32_t tLocal = 0;
+    double tInc = (double)formulaRate / (double)outputRate;
+
+    for (uint32_t i = 0; i < count; i++) {
+        int v = engine.Eval(tLocal);
+        out[i] = (unsigned char)(v & 0xFF);
+
+        tAccumLocal += tInc;
+        if (tAccumLocal >= 1.0) {
+            uint32_t steps = (uint32_t)tAccumLocal;
+            tLocal += steps;
+            tAccumLocal -= (double)steps;
+        }
+        if (progress && i % 5000 == 0) *progress = (float)i / count;
+    }
+}
+
+bool WriteWavFile(const string& path, const uint8_t* samples, size_t count, int sampleRate) {
+    FILE* f = fopen(path.c_str(), "wb");
+    if (!f) return false;
+
+    uint32_t totalSamples = (uint32_t)count;
+    uint32_t rate = (uint32_t)sampleRate;
+
+    // HEADER WAV
+    fwrite("RIFF", 1, 4, f);
+    uint32_t chunkSize = 36 + totalSamples; fwrite(&chunkSize, 4, 1, f);
+    fwrite("WAVE", 1, 4, f);
+    fwrite("fmt ", 1, 4, f);
+    uint32_t s1 = 16; fwrite(&s1, 4, 1, f);
+    uint16_t alg = 1; fwrite(&alg, 2, 1, f);
+    uint16_t ch = 1; fwrite(&ch, 2, 1, f);
+    fwrite(&rate, 4, 1, f);
+    uint32_t br = rate; fwrite(&br, 4, 1, f);
+    uint16_t ba = 1; fwrite(&ba, 2, 1, f);
+    uint16_t bps = 8; fwrite(&bps, 2, 1, f);
+    fwrite("data", 1, 4, f);
+    fwrite(&totalSamples, 4, 1, f);
+
+    // DATA
+    size_t written = fwrite(samples, 1, count, f);
+    fclose(f);
+    return written == count;
+}
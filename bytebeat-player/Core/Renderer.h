@@ -0,0 +1,13 @@
+﻿#pragma once
+#include "Bytebeat.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Renders count samples at outputRate while t advances at formulaRate (sample-and-hold,
+// same stepping as the audio callback). progress, if given, is updated in [0, 1).
+void RenderSamples(ComplexEngine& engine, int formulaRate, int outputRate,
+    uint32_t count, uint8_t* out, float* progress = nullptr);
+
+// Writes unsigned 8-bit mono PCM as a RIFF/WAVE file
+bool WriteWavFile(const std::string& path, const uint8_t* samples, size_t count, int sampleRate);
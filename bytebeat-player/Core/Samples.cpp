@@ -0,0 +1,131 @@
+﻿#include "Samples.h"
+#include "Bytebeat.h"
+#include <algorithm>
+#include <cctype>
+#include <mutex>
+
+using namespace std;
+
+// Compiles can run on worker threads (overview, t-plot) while the UI imports
+static mutex g_samplesMutex;
+static vector<SampleData> g_samples;
+static vector<ChunkData> g_chunks;
+
+int AddSample(vector<uint8_t> bytes) {
+    lock_guard<mutex> lock(g_samplesMutex);
+    g_samples.push_back(make_shared<const vector<uint8_t>>(move(bytes)));
+    return (int)g_samples.size() - 1;
+}
+
+SampleData GetSample(int id) {
+    lock_guard<mutex> lock(g_samplesMutex);
+    if (id < 0 || id >= (int)g_samples.size()) return nullptr;
+    return g_samples[id];
+}
+
+int AddChunk(string source, vector<uint8_t> bytes) {
+    lock_guard<mutex> lock(g_samplesMutex);
+    // Reloading the same preset must not grow the table
+    for (size_t i = 0; i < g_chunks.size(); i++) {
+        if (g_chunks[i]->source == source) return (int)i;
+    }
+    auto chunk = make_shared<HiddenChunk>();
+    chunk->source = move(source);
+    chunk->bytes = make_shared<const vector<uint8_t>>(move(bytes));
+    g_chunks.push_back(move(chunk));
+    return (int)g_chunks.size() - 1;
+}
+
+ChunkData GetChunk(int id) {
+    lock_guard<mutex> lock(g_samplesMutex);
+    if (id < 0 || id >= (int)g_chunks.size()) return nullptr;
+    return g_chunks[id];
+}
+
+string CompressCode(const string& code) {
+    string out;
+    out.reserve(min<size_t>(code.size(), 4096));
+    string decoded;
+
+    for (size_t i = 0; i < code.size(); ) {
+        char c = code[i];
+        if (c != '\'' && c != '"') {
+            out += c;
+            i++;
+            continue;
+        }
+
+        size_t end = ParseStringLiteral(code, i, decoded);
+        if (end - i > 1000) {
+            // Big literals live in the chunk table, the editor only carries the handle
+            int id = AddChunk(code.substr(i, end - i), vector<uint8_t>(decoded.begin(), decoded.end()));
+            out += "@chunk(" + to_string(id) + ")";
+        }
+        else out.append(code, i, end - i);
+        i = end;
+    }
+    return out;
+}
+
+// N of a handle whose digits start at i, read the way the tokenizer does: digits running
+// straight up to ')'. end receives the position after ')'; -1 for anything else.
+static int ParseHandle(const string& code, size_t i, size_t& end) {
+    int id = 0;
+    bool digits = false;
+    while (i < code.size() && isdigit((unsigned char)code[i]) && id < 100000) {
+        id = id * 10 + (code[i++] - '0');
+        digits = true;
+    }
+    if (!digits || i >= code.size() || code[i] != ')') return -1;
+    end = i + 1;
+    return id;
+}
+
+string ExpandCode(const string& code) {
+    static const char* hex = "0123456789ABCDEF";
+    string out;
+    string decoded;
+
+    for (size_t i = 0; i < code.size(); ) {
+        char c = code[i];
+        // Quoted text is copied as is, a "@chunk(" inside it is not a handle
+        if (c == '\'' || c == '"') {
+            size_t end = ParseStringLiteral(code, i, decoded);
+            out.append(code, i, end - i);
+            i = end;
+            continue;
+        }
+
+        size_t end = 0;
+        ChunkData chunk;
+        SampleData sample;
+        if (c == '@' && code.compare(i, 7, "@chunk(") == 0) {
+            int id = ParseHandle(code, i + 7, end);
+            if (id >= 0) chunk = GetChunk(id);
+        }
+        else if (c == '@' && code.compare(i, 8, "@sample(") == 0) {
+            int id = ParseHandle(code, i + 8, end);
+            if (id >= 0) sample = GetSample(id);
+        }
+
+        if (chunk) out += chunk->source;
+        else if (sample) {
+            // Samples only exist in this session, so they leave as a quoted '\xNN...' literal
+            out.reserve(out.size() + sample->size() * 4 + 2);
+            out += '\'';
+            for (uint8_t b : *sample) {
+                out += "\\x";
+                out += hex[b >> 4];
+                out += hex[b & 15];
+            }
+            out += '\'';
+        }
+        else {
+            out += c;
+            i++;
+            continue;
+        }
+        i = end;
+    }
+    return out;
+}
@@ -0,0 +1,36 @@
+﻿#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Imported audio, referenced from formulas as @sample(N). Compiled programs share the bytes
+// instead of parsing them from string literals.
+using SampleData = std::shared_ptr<const std::vector<uint8_t>>;
+
+// Registers bytes and returns N for @sample(N)
+int AddSample(std::vector<uint8_t> bytes);
+
+// nullptr if there is no sample N
+SampleData GetSample(int id);
+
+
+// Long string literals the editor shows as @chunk(N). The source text is kept for copying the
+// formula; compiles resolve the handle to the already decoded bytes without expanding the text.
+struct HiddenChunk {
+    std::string source; // Quoted literal as written
+    SampleData bytes;
+};
+using ChunkData = std::shared_ptr<const HiddenChunk>;
+
+// Registers a literal and returns N for @chunk(N); identical sources share one handle
+int AddChunk(std::string source, std::vector<uint8_t> bytes);
+
+// nullptr if there is no chunk N
+ChunkData GetChunk(int id);
+
+// Editor text from a full formula: string literals over 1000 characters become @chunk(N)
+std::string CompressCode(const std::string& fullCode);
+// Full formula from editor text, for copying it out: @chunk(N) gets its source back and
+// @sample(N) becomes a quoted '\xNN...' literal, so the result works outside this session
+std::string ExpandCode(const std::string& shortCode);
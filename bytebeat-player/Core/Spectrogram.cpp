@@ -0,0 +1,79 @@
+﻿#include "Spectrogram.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+static const float DB_RANGE = 96.0f;
+
+void Spectrogram::Load() {
+    if (m_loaded) return;
+
+    // Black -> blue -> magenta -> orange -> pale yellow
+    const float stops[5][3] = { { 0, 0, 0 }, { 20, 20, 120 }, { 170, 30, 140 }, { 250, 140, 30 }, { 255, 250, 190 } };
+    for (int i = 0; i < 256; i++) {
+        float x = i / 255.0f * 4.0f;
+        int s = min((int)x, 3);
+        float f = x - s;
+        m_palette[i] = {
+            (unsigned char)(stops[s][0] + (stops[s + 1][0] - stops[s][0]) * f),
+            (unsigned char)(stops[s][1] + (stops[s + 1][1] - stops[s][1]) * f),
+            (unsigned char)(stops[s][2] + (stops[s + 1][2] - stops[s][2]) * f),
+            255
+        };
+    }
+
+    Image img = GenImageColor(WIDTH, HEIGHT, m_palette[0]);
+    m_texture = LoadTextureFromImage(img);
+    UnloadImage(img);
+    m_head = 0;
+    m_loaded = true;
+}
+
+void Spectrogram::Unload() {
+    if (!m_loaded) return;
+    UnloadTexture(m_texture);
+    m_loaded = false;
+}
+
+void Spectrogram::MapRows(int bins, float sampleRate) {
+    m_rowBins = bins;
+    m_rowRate = sampleRate;
+
+    float fMax = sampleRate * 0.5f;
+    float fMin = max(20.0f, fMax / bins);
+    float logSpan = logf(fMax / fMin);
+    for (int r = 0; r < HEIGHT; r++) {
+        float fHi = fMin * expf(logSpan * (HEIGHT - r) / HEIGHT);
+        float fLo = fMin * expf(logSpan * (HEIGHT - r - 1) / HEIGHT);
+        m_rowFirst[r] = clamp((int)(fLo / fMax * bins), 1, bins);
+        m_rowLast[r] = clamp((int)(fHi / fMax * bins), m_rowFirst[r], bins);
+    }
+}
+
+void Spectrogram::Push(const vector<float>& db, float sampleRate) {
+    if (!m_loaded || db.size() < 3) return;
+    int bins = (int)db.size() - 1;
+    if (bins != m_rowBins || sampleRate != m_rowRate) MapRows(bins, sampleRate);
+
+    for (int r = 0; r < HEIGHT; r++) {
+        float v = -DB_RANGE;
+        for (int b = m_rowFirst[r]; b <= m_rowLast[r]; b++) v = max(v, db[b]);
+        int idx = (int)((v + DB_RANGE) / DB_RANGE * 255.0f);
+        m_column[r] = m_palette[clamp(idx, 0, 255)];
+    }
+
+    UpdateTextureRec(m_texture, { (float)m_head, 0.0f, 1.0f, (float)HEIGHT }, m_column);
+    m_head = (m_head + 1) % WIDTH;
+}
+
+void Spectrogram::Draw(ImDrawList* dl, ImVec2 pos, ImVec2 size) const {
+    if (!m_loaded || size.x <= 0.0f || size.y <= 0.0f) return;
+    ImTextureID id = ImTextureID(m_texture.id);
+
+    // Columns [head, WIDTH) are the oldest, [0, head) the newest
+    float split = pos.x + size.x * (float)(WIDTH - m_head) / WIDTH;
+    float u = (float)m_head / WIDTH;
+    dl->AddImage(id, pos, { split, pos.y + size.y }, { u, 0.0f }, { 1.0f, 1.0f });
+    if (m_head > 0) dl->AddImage(id, { split, pos.y }, { pos.x + size.x, pos.y + size.y }, { 0.0f, 0.0f }, { u, 1.0f });
+}
@@ -0,0 +1,37 @@
+﻿#pragma once
+#include "raylib.h"
+#include "imgui.h"
+#include <vector>
+
+// Scrolling spectrogram kept in a texture ring: each spectrum becomes one column and only
+// that column is uploaded, so frame cost doesn't depend on how much history is shown.
+class Spectrogram {
+public:
+    static constexpr int WIDTH = 512;   // Columns of history
+    static constexpr int HEIGHT = 256;  // Log-frequency rows, highest frequency on top
+
+    void Load();    // Needs the GL context
+    void Unload();
+
+    // Converts one spectrum (dBFS per bin) to a column and uploads it at the write head
+    void Push(const std::vector<float>& db, float sampleRate);
+
+    // Draws the ring oldest to newest, left to right
+    void Draw(ImDrawList* dl, ImVec2 pos, ImVec2 size) const;
+
+private:
+    void MapRows(int bins, float sampleRate);
+
+    Texture2D m_texture = {};
+    bool m_loaded = false;
+    int m_head = 0;
+
+    Color m_palette[256];
+    Color m_column[HEIGHT];
+
+    // Bin range per row, rebuilt when FFT size or rate changes
+    int m_rowBins = 0;
+    float m_rowRate = 0.0f;
+    int m_rowFirst[HEIGHT];
+    int m_rowLast[HEIGHT];
+};
@@ -0,0 +1,96 @@
+﻿#include "Spectrum.h"
+#include "Fft.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+using namespace std;
+
+void SpectrumAnalyzer::Start(const CaptureRing& ring) {
+    if (m_running) return;
+    m_ring = &ring;
+    m_running = true;
+    m_thread = thread(&SpectrumAnalyzer::Run, this);
+}
+
+void SpectrumAnalyzer::Stop() {
+    m_running = false;
+    if (m_thread.joinable()) m_thread.join();
+}
+
+bool SpectrumAnalyzer::Latest(vector<float>& db, uint64_t& serial) {
+    lock_guard<mutex> lock(m_mutex);
+    if (m_serial == serial) return false;
+    db = m_front;
+    serial = m_serial;
+    return true;
+}
+
+void SpectrumAnalyzer::DrainColumns(vector<vector<float>>& out) {
+    out.clear();
+    lock_guard<mutex> lock(m_mutex);
+    while (!m_pending.empty()) {
+        out.push_back(move(m_pending.front()));
+        m_pending.pop_front();
+    }
+}
+
+void SpectrumAnalyzer::Run() {
+    RealFft fft;
+    vector<uint8_t> raw;
+    vector<float> window, in, re, im, back;
+    float scale = 0.0f;
+    uint32_t size = 0;
+    uint64_t analyzed = 0;
+
+    while (m_running) {
+        uint32_t n = 1u << clamp(sizeLog2.load(), MIN_SIZE_LOG2, MAX_SIZE_LOG2);
+        if (n != size) {
+            size = n;
+            fft.Resize(n);
+            raw.resize(n);
+            in.resize(n);
+            re.resize(n / 2 + 1);
+            im.resize(n / 2 + 1);
+            window.resize(n);
+            double sum = 0.0;
+            for (uint32_t i = 0; i < n; i++) {
+                window[i] = 0.5f - 0.5f * (float)cos(2.0 * 3.14159265358979323846 * i / n);
+                sum += window[i];
+            }
+            // Full-scale sine reads 0 dB
+            scale = (float)(2.0 / sum);
+            analyzed = m_ring->WriteCount();
+        }
+
+        uint32_t hop = max(1u, n >> clamp(overlapLog2.load(), 0, 4));
+        uint64_t written = m_ring->WriteCount();
+        if (written < n || written - analyzed < hop) {
+            this_thread::sleep_for(chrono::milliseconds(2));
+            continue;
+        }
+        // One column per hop of the backlog, however many hops the callback wrote at once. Only
+        // when the ring lapped the backlog does analysis start over at the newest samples.
+        uint64_t end = max<uint64_t>(analyzed + hop, n);
+        if (!m_ring->Read(end, n, raw.data())) {
+            analyzed = written;
+            continue;
+        }
+        analyzed = end;
+
+        for (uint32_t i = 0; i < n; i++) in[i] = ((float)raw[i] - 128.0f) / 128.0f * window[i];
+        fft.Forward(in.data(), re.data(), im.data());
+
+        back.resize(n / 2 + 1);
+        for (uint32_t k = 0; k <= n / 2; k++) {
+            float mag = sqrtf(re[k] * re[k] + im[k] * im[k]) * scale;
+            back[k] = 20.0f * log10f(mag + 1e-6f);
+        }
+
+        lock_guard<mutex> lock(m_mutex);
+        if (m_pending.size() >= MAX_PENDING) m_pending.pop_front();
+        m_pending.push_back(back);
+        m_front.swap(back);
+        m_serial++;
+    }
+}
@@ -0,0 +1,45 @@
+﻿#pragma once
+#include "CaptureRing.h"
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Background spectrum analysis of the capture ring. A worker thread steps through the
+// captured samples one hop at a time, windows them (Hann), runs the FFT and publishes
+// magnitudes through a double buffer, so neither the audio callback nor the UI frame pays
+// for the transform.
+class SpectrumAnalyzer {
+public:
+    static constexpr int MIN_SIZE_LOG2 = 9;   // 512
+    static constexpr int MAX_SIZE_LOG2 = 14;  // 16384
+    static constexpr size_t MAX_PENDING = 64; // Hops kept for DrainColumns before the oldest are dropped
+
+    std::atomic<int> sizeLog2{ 12 };
+    std::atomic<int> overlapLog2{ 2 };        // Hop = size >> overlapLog2 (0 = no overlap, 2 = 75 %)
+
+    ~SpectrumAnalyzer() { Stop(); }
+
+    void Start(const CaptureRing& ring);
+    void Stop();
+
+    // Copies the newest spectrum (dBFS per bin, size / 2 + 1 bins) if it changed since serial
+    bool Latest(std::vector<float>& db, uint64_t& serial);
+
+    // Moves every spectrum produced since the previous call into out, oldest first (one per hop)
+    void DrainColumns(std::vector<std::vector<float>>& out);
+
+private:
+    void Run();
+
+    const CaptureRing* m_ring = nullptr;
+    std::thread m_thread;
+    std::atomic<bool> m_running{ false };
+
+    std::mutex m_mutex;                       // Guards the front buffer, serial and pending columns
+    std::vector<float> m_front;
+    std::deque<std::vector<float>> m_pending;
+    uint64_t m_serial = 0;
+};
@@ -0,0 +1,121 @@
+﻿#include "TPlot.h"
+#include "Bytebeat.h"
+#include <algorithm>
+
+using namespace std;
+
+void TPlot::Load() {
+    if (m_loaded) return;
+    m_columns.assign((size_t)COLUMNS * ROWS, 0);
+    m_dirty.assign(COLUMNS, 0);
+
+    Image img = {};
+    img.data = m_columns.data(); // All zero, layout doesn't matter
+    img.width = COLUMNS;
+    img.height = ROWS;
+    img.mipmaps = 1;
+    img.format = PIXELFORMAT_UNCOMPRESSED_GRAYSCALE;
+    m_texture = LoadTextureFromImage(img);
+    m_loaded = true;
+}
+
+void TPlot::Unload() {
+    StopOffline();
+    if (!m_loaded) return;
+    UnloadTexture(m_texture);
+    m_loaded = false;
+}
+
+void TPlot::Upload(int column, const uint8_t* pixels) {
+    UpdateTextureRec(m_texture, { (float)column, 0.0f, 1.0f, (float)ROWS }, pixels);
+}
+
+void TPlot::Clear() {
+    fill(m_columns.begin(), m_columns.end(), 0);
+    UpdateTexture(m_texture, m_columns.data());
+}
+
+void TPlot::UpdateLive(const CaptureRing& ring) {
+    if (!m_loaded) return;
+    if (!m_liveActive) {
+        // Coming from offline mode (or first use): start from an empty picture at the write head
+        StopOffline();
+        m_offlineCode.clear();
+        Clear();
+        m_consumed = ring.WriteCount();
+        m_liveActive = true;
+    }
+
+    uint64_t written = ring.WriteCount();
+    uint64_t count = min<uint64_t>(written - m_consumed, CaptureRing::HISTORY);
+    if (count == 0) return;
+    m_values.resize((size_t)count);
+    m_times.resize((size_t)count);
+    if (!ring.Read(written, (uint32_t)count, m_values.data(), m_times.data())) {
+        m_consumed = written;
+        return;
+    }
+    m_consumed = written;
+
+    for (size_t i = 0; i < m_values.size(); i++) {
+        uint32_t t = m_times[i];
+        int col = (int)((t >> 8) % COLUMNS);
+        m_columns[(size_t)col * ROWS + (t & 255)] = m_values[i];
+        m_dirty[col] = 1;
+    }
+    m_head = (int)(((m_times.back() >> 8) + 1) % COLUMNS);
+
+    for (int c = 0; c < COLUMNS; c++) {
+        if (!m_dirty[c]) continue;
+        Upload(c, &m_columns[(size_t)c * ROWS]);
+        m_dirty[c] = 0;
+    }
+}
+
+void TPlot::StartOffline(const string& code) {
+    StopOffline();
+    m_liveActive = false;
+    m_offlineCode = code;
+    m_offline.assign((size_t)COLUMNS * ROWS, 0);
+    m_offlineDone = 0;
+    m_offlineUploaded = 0;
+    if (m_loaded) Clear();
+
+    m_offlineRunning = true;
+    m_offlineThread = thread([this] {
+        ComplexEngine engine;
+        string err;
+        int errorPos = -1;
+        if (!engine.Compile(m_offlineCode, err, errorPos)) return;
+        for (int c = 0; c < COLUMNS && m_offlineRunning; c++) {
+            uint8_t* column = &m_offline[(size_t)c * ROWS];
+            for (uint32_t r = 0; r < ROWS; r++) column[r] = (uint8_t)(engine.Eval(((uint32_t)c << 8) | r) & 0xFF);
+            m_offlineDone.store(c + 1, memory_order_release);
+        }
+    });
+}
+
+void TPlot::StopOffline() {
+    m_offlineRunning = false;
+    if (m_offlineThread.joinable()) m_offlineThread.join();
+}
+
+void TPlot::UpdateOffline() {
+    if (!m_loaded) return;
+    int done = m_offlineDone.load(memory_order_acquire);
+    for (; m_offlineUploaded < done; m_offlineUploaded++) {
+        Upload(m_offlineUploaded, &m_offline[(size_t)m_offlineUploaded * ROWS]);
+    }
+}
+
+void TPlot::Draw(ImDrawList* dl, ImVec2 pos, ImVec2 size, bool live) const {
+    if (!m_loaded || size.x <= 0.0f || size.y <= 0.0f) return;
+    ImTextureID id = ImTextureID(m_texture.id);
+    int head = live ? m_head : 0;
+
+    // Columns [head, COLUMNS) first, then [0, head)
+    float split = pos.x + size.x * (float)(COLUMNS - head) / COLUMNS;
+    float u = (float)head / COLUMNS;
+    dl->AddImage(id, pos, { split, pos.y + size.y }, { u, 0.0f }, { 1.0f, 1.0f });
+    if (head > 0) dl->AddImage(id, { split, pos.y }, { pos.x + size.x, pos.y + size.y }, { 0.0f, 0.0f }, { u, 1.0f });
+}
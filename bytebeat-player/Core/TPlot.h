@@ -0,0 +1,58 @@
+﻿#pragma once
+#include "CaptureRing.h"
+#include "raylib.h"
+#include "imgui.h"
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Classic bytebeat picture: x = t >> 8, y = t & 255, brightness = output. Backed by a grayscale
+// texture that only receives the columns that changed, so showing it costs one image draw.
+class TPlot {
+public:
+    static constexpr int ROWS = 256;
+    static constexpr int COLUMNS = 2048;    // 512k t values
+
+    ~TPlot() { StopOffline(); }
+
+    void Load();    // Needs the GL context
+    void Unload();
+
+    // Live: plots what the audio callback played since the previous call
+    void UpdateLive(const CaptureRing& ring);
+
+    // Offline: renders t = 0 .. COLUMNS * 256 on a worker, finished columns appear as they complete
+    void StartOffline(const std::string& code);
+    void StopOffline();
+    void UpdateOffline();
+    const std::string& OfflineCode() const { return m_offlineCode; }
+    float OfflineProgress() const { return (float)m_offlineDone.load() / COLUMNS; }
+
+    // Live mode scrolls with the newest column on the right; offline starts at t = 0
+    void Draw(ImDrawList* dl, ImVec2 pos, ImVec2 size, bool live) const;
+
+private:
+    void Upload(int column, const uint8_t* pixels);
+    void Clear();
+
+    Texture2D m_texture = {};
+    bool m_loaded = false;
+
+    // Live: column-major copy of the texture so a column uploads as one contiguous span
+    std::vector<uint8_t> m_columns;
+    std::vector<uint8_t> m_dirty;
+    std::vector<uint8_t> m_values;
+    std::vector<uint32_t> m_times;
+    uint64_t m_consumed = 0;
+    int m_head = 0;
+    bool m_liveActive = false;
+
+    // Offline
+    std::string m_offlineCode;
+    std::vector<uint8_t> m_offline;
+    std::thread m_offlineThread;
+    std::atomic<bool> m_offlineRunning{ false };
+    std::atomic<int> m_offlineDone{ 0 };
+    int m_offlineUploaded = 0;
+};
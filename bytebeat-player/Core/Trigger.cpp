@@ -0,0 +1,94 @@
+﻿#include "Trigger.h"
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define TRIGGER_SSE2 1
+#endif
+
+using namespace std;
+
+static inline bool IsEdge(uint8_t a, uint8_t b, uint8_t level, bool rising) {
+    return rising ? (a <= level && b > level) : (a > level && b <= level);
+}
+
+int FindLastEdge(const uint8_t* samples, uint32_t count, uint8_t level, bool rising) {
+    if (count < 2) return -1;
+    int positions = (int)count - 1;
+    int blocks = positions & ~15;
+
+    // Tail that doesn't fill a 16-wide block
+    for (int i = positions - 1; i >= blocks; i--) {
+        if (IsEdge(samples[i], samples[i + 1], level, rising)) return i;
+    }
+
+#ifdef TRIGGER_SSE2
+    // Unsigned compare via sign flip: x > level  <=>  (x ^ 0x80) > (level ^ 0x80) as signed
+    const __m128i bias = _mm_set1_epi8((char)0x80);
+    const __m128i lvl = _mm_set1_epi8((char)(level ^ 0x80));
+    for (int b = blocks - 16; b >= 0; b -= 16) {
+        __m128i a = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(samples + b)), bias);
+        __m128i c = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(samples + b + 1)), bias);
+        __m128i aAbove = _mm_cmpgt_epi8(a, lvl);
+        __m128i cAbove = _mm_cmpgt_epi8(c, lvl);
+        __m128i hit = rising ? _mm_andnot_si128(aAbove, cAbove) : _mm_andnot_si128(cAbove, aAbove);
+        int mask = _mm_movemask_epi8(hit);
+        if (mask) {
+            int k = 15;
+            while (!(mask & (1 << k))) k--;
+            return b + k;
+        }
+    }
+#else
+    for (int i = blocks - 1; i >= 0; i--) {
+        if (IsEdge(samples[i], samples[i + 1], level, rising)) return i;
+    }
+#endif
+    return -1;
+}
+
+void TriggerEngine::Reset() {
+    m_scanned = 0;
+    m_trigger = 0;
+    m_hasTrigger = false;
+}
+
+bool TriggerEngine::Update(const CaptureRing& ring, uint32_t span, uint64_t& start) {
+    span = clamp(span, 2u, CaptureRing::HISTORY);
+    uint64_t written = ring.WriteCount();
+    if (written < (uint64_t)span + 1) return false;
+
+    // Latest start that still fits a full window (and the sample after an edge)
+    uint64_t limit = written - span;
+    uint64_t oldest = written > CaptureRing::HISTORY ? written - CaptureRing::HISTORY : 0;
+
+    // Zooming out can push the held trigger past the newest valid start
+    if (m_hasTrigger && (m_trigger > limit || m_trigger < oldest)) Reset();
+
+    if (mode == TRIGGER_OFF) {
+        start = limit;
+        return true;
+    }
+
+    // Search only positions captured since the last frame
+    uint64_t lo = max(m_scanned, max(oldest, limit + 1 > MAX_SCAN ? limit + 1 - MAX_SCAN : (uint64_t)0));
+    if (lo <= limit) {
+        uint32_t count = (uint32_t)(limit - lo) + 2;
+        if (ring.Read(lo + count, count, m_buf)) {
+            int edge = FindLastEdge(m_buf, count, (uint8_t)clamp(level, 0, 255), mode != TRIGGER_FALLING);
+            if (edge >= 0) {
+                uint64_t pos = lo + (uint64_t)edge;
+                if (!m_hasTrigger || pos >= m_trigger + (uint64_t)max(holdoff, 0)) {
+                    m_trigger = pos;
+                    m_hasTrigger = true;
+                }
+            }
+        }
+        m_scanned = limit + 1;
+    }
+
+    // Auto free-runs once the held edge is older than a full scan range
+    bool stale = mode == TRIGGER_AUTO && m_hasTrigger && limit - m_trigger >= MAX_SCAN + (uint64_t)max(holdoff, 0);
+    start = (m_hasTrigger && !stale) ? m_trigger : limit;
+    return true;
+}
@@ -0,0 +1,37 @@
+﻿#pragma once
+#include "CaptureRing.h"
+#include <cstdint>
+
+enum TriggerMode {
+    TRIGGER_OFF,     // Free run: always show the newest samples
+    TRIGGER_RISING,  // Hold the last rising edge through the level
+    TRIGGER_FALLING, // Hold the last falling edge through the level
+    TRIGGER_AUTO     // Rising edge, free runs when no edge shows up for a while
+};
+
+// Index i of the last edge in samples[0..count), i.e. samples[i] <= level < samples[i + 1]
+// for rising edges (mirrored for falling). Returns -1 if there is none.
+int FindLastEdge(const uint8_t* samples, uint32_t count, uint8_t level, bool rising);
+
+// Picks where the scope window starts in the capture ring. State is kept across frames:
+// only samples captured since the previous Update are searched (at most MAX_SCAN), so
+// the cost per frame stays small and constant at every zoom level.
+class TriggerEngine {
+public:
+    static constexpr uint32_t MAX_SCAN = 4096;
+
+    int mode = TRIGGER_AUTO;
+    int level = 2;       // 0..255
+    int holdoff = 0;     // Minimum samples between two accepted triggers
+
+    // Sequence number where a window of span samples should start. False while the ring
+    // holds fewer than span + 1 samples.
+    bool Update(const CaptureRing& ring, uint32_t span, uint64_t& start);
+    void Reset();
+
+private:
+    uint64_t m_scanned = 0;   // Edge positions below this have been searched
+    uint64_t m_trigger = 0;
+    bool m_hasTrigger = false;
+    uint8_t m_buf[MAX_SCAN + 1];
+};
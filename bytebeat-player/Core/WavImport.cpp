@@ -0,0 +1,290 @@
+﻿#include "WavImport.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+// Read-only view of a whole file; pages are only touched as blocks are decoded
+class MappedFile {
+public:
+    explicit MappedFile(const string& path) {
+#ifdef _WIN32
+        m_file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (m_file == INVALID_HANDLE_VALUE) return;
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx(m_file, &size) || size.QuadPart == 0) return;
+        m_mapping = CreateFileMappingA(m_file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (!m_mapping) return;
+        m_data = (const uint8_t*)MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0);
+        if (m_data) m_size = (size_t)size.QuadPart;
+#else
+        m_fd = open(path.c_str(), O_RDONLY);
+        if (m_fd < 0) return;
+        struct stat st;
+        if (fstat(m_fd, &st) != 0 || st.st_size == 0) return;
+        void* p = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, m_fd, 0);
+        if (p == MAP_FAILED) return;
+        madvise(p, (size_t)st.st_size, MADV_SEQUENTIAL);
+        m_data = (const uint8_t*)p;
+        m_size = (size_t)st.st_size;
+#endif
+    }
+
+    ~MappedFile() {
+#ifdef _WIN32
+        if (m_data) UnmapViewOfFile(m_data);
+        if (m_mapping) CloseHandle(m_mapping);
+        if (m_file != INVALID_HANDLE_VALUE) CloseHandle(m_file);
+#else
+        if (m_data) munmap((void*)m_data, m_size);
+        if (m_fd >= 0) close(m_fd);
+#endif
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const uint8_t* Data() const { return m_data; }
+    size_t Size() const { return m_size; }
+
+private:
+    const uint8_t* m_data = nullptr;
+    size_t m_size = 0;
+#ifdef _WIN32
+    HANDLE m_file = INVALID_HANDLE_VALUE;
+    HANDLE m_mapping = NULL;
+#else
+    int m_fd = -1;
+#endif
+};
+
+static uint16_t ReadU16(const uint8_t* p) { return (uint16_t)(p[0] | (p[1] << 8)); }
+static uint32_t ReadU32(const uint8_t* p) { return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24); }
+
+struct WavFormat {
+    bool isFloat = false;
+    int channels = 0;
+    int sampleRate = 0;
+    int bits = 0;
+    int blockAlign = 0;
+    const uint8_t* data = nullptr;
+    uint64_t frames = 0;
+};
+
+static bool ParseChunks(const MappedFile& file, WavFormat& fmt, string& error) {
+    const uint8_t* p = file.Data();
+    size_t size = file.Size();
+    if (size < 12 || memcmp(p, "RIFF", 4) != 0 || memcmp(p + 8, "WAVE", 4) != 0) {
+        error = "Not a RIFF/WAVE file";
+        return false;
+    }
+
+    bool haveFmt = false;
+    size_t pos = 12;
+    while (pos + 8 <= size) {
+        const uint8_t* chunk = p + pos;
+        uint64_t chunkSize = ReadU32(chunk + 4);
+        uint64_t available = size - pos - 8;
+
+        if (memcmp(chunk, "fmt ", 4) == 0 && chunkSize >= 16 && chunkSize <= available) {
+            int tag = ReadU16(chunk + 8);
+            fmt.channels = ReadU16(chunk + 10);
+            fmt.sampleRate = (int)ReadU32(chunk + 12);
+            fmt.blockAlign = ReadU16(chunk + 20);
+            fmt.bits = ReadU16(chunk + 22);
+            if (tag == 0xFFFE && chunkSize >= 40) tag = ReadU16(chunk + 32); // WAVE_FORMAT_EXTENSIBLE sub-format
+            if (tag != 1 && tag != 3) {
+                error = "Unsupported WAV encoding (only PCM and float)";
+                return false;
+            }
+            fmt.isFloat = tag == 3;
+            haveFmt = true;
+        }
+        else if (memcmp(chunk, "data", 4) == 0) {
+            if (!haveFmt) {
+                error = "WAV data before format chunk";
+                return false;
+            }
+            // Truncated files keep whatever was written
+            fmt.data = chunk + 8;
+            fmt.frames = fmt.blockAlign > 0 ? min(chunkSize, available) / fmt.blockAlign : 0;
+            break;
+        }
+        pos += 8 + (size_t)chunkSize + (chunkSize & 1);
+    }
+
+    if (!haveFmt || !fmt.data) {
+        error = "WAV file has no audio data";
+        return false;
+    }
+    bool bitsOk = fmt.isFloat ? (fmt.bits == 32 || fmt.bits == 64) : (fmt.bits == 8 || fmt.bits == 16 || fmt.bits == 24 || fmt.bits == 32);
+    if (!bitsOk || fmt.channels <= 0 || fmt.sampleRate <= 0 || fmt.blockAlign < fmt.channels * fmt.bits / 8) {
+        error = "Unsupported WAV format";
+        return false;
+    }
+    return true;
+}
+
+// Mono average of frames [first, first + count) as floats in [-1, 1]
+static void DecodeMono(const WavFormat& fmt, uint64_t first, size_t count, float* out) {
+    const int bytes = fmt.bits / 8;
+    const float scale = 1.0f / fmt.channels;
+    for (size_t i = 0; i < count; i++) {
+        const uint8_t* frame = fmt.data + (first + i) * fmt.blockAlign;
+        float sum = 0.0f;
+        for (int c = 0; c < fmt.channels; c++) {
+            const uint8_t* s = frame + c * bytes;
+            float v;
+            if (fmt.isFloat) {
+                if (bytes == 4) { float f; memcpy(&f, s, 4); v = f; }
+                else { double d; memcpy(&d, s, 8); v = (float)d; }
+            }
+            else if (bytes == 1) v = (s[0] - 128) / 128.0f;
+            else if (bytes == 2) v = (int16_t)ReadU16(s) / 32768.0f;
+            else if (bytes == 3) v = (float)((int32_t)(((uint32_t)s[0] << 8) | ((uint32_t)s[1] << 16) | ((uint32_t)s[2] << 24)) >> 8) / 8388608.0f;
+            else v = (float)((int32_t)ReadU32(s) / 2147483648.0);
+            sum += v;
+        }
+        out[i] = sum * scale;
+    }
+}
+
+static uint8_t ToUnsigned8(float v) {
+    return (uint8_t)clamp((int)lrintf(v * 127.0f + 128.0f), 0, 255);
+}
+
+int PickImportRate(int sourceRate, const vector<int>& rates) {
+    int best = rates.empty() ? sourceRate : rates[0];
+    for (int r : rates) {
+        if (abs(r - sourceRate) < abs(best - sourceRate)) best = r;
+    }
+    return best;
+}
+
+bool ImportWav(const string& path, const vector<int>& rates, WavImportResult& out,
+    atomic<float>* progress, const atomic<bool>* cancel) {
+    out = WavImportResult();
+    MappedFile file(path);
+    if (!file.Data()) {
+        out.error = "Can't open '" + path + "'";
+        return false;
+    }
+
+    WavFormat fmt;
+    if (!ParseChunks(file, fmt, out.error)) return false;
+
+    out.sourceRate = fmt.sampleRate;
+    out.sampleRate = PickImportRate(fmt.sampleRate, rates);
+    const double step = (double)fmt.sampleRate / out.sampleRate; // Input frames per output sample
+    const uint64_t outCount = (uint64_t)floor(fmt.frames / step);
+    if (outCount == 0) {
+        out.error = "WAV file is empty";
+        return false;
+    }
+    out.samples.resize((size_t)outCount);
+
+    // Windowed sinc (Blackman), cutoff lowered to the output Nyquist when downsampling
+    const int zeroCrossings = 16;
+    const int tableRes = 512;
+    const double cutoff = min(1.0, 1.0 / step) * (step == 1.0 ? 1.0 : 0.95);
+    const double halfWidth = zeroCrossings / cutoff; // In input frames
+    vector<float> table(zeroCrossings * tableRes + 2, 0.0f);
+    for (int i = 0; i <= zeroCrossings * tableRes; i++) {
+        double u = (double)i / tableRes;
+        double sinc = u == 0.0 ? 1.0 : sin(3.14159265358979323846 * u) / (3.14159265358979323846 * u);
+        double w = 0.42 + 0.5 * cos(3.14159265358979323846 * u / zeroCrossings) + 0.08 * cos(2.0 * 3.14159265358979323846 * u / zeroCrossings);
+        table[i] = (float)(sinc * w);
+    }
+
+    const size_t block = 16384; // Output samples per block
+    vector<float> in;
+    for (uint64_t n0 = 0; n0 < outCount; n0 += block) {
+        if (cancel && cancel->load()) {
+            out.error = "Import cancelled";
+            return false;
+        }
+        size_t n = (size_t)min<uint64_t>(block, outCount - n0);
+
+        if (step == 1.0) {
+            in.resize(n);
+            DecodeMono(fmt, n0, n, in.data());
+            for (size_t i = 0; i < n; i++) out.samples[(size_t)(n0 + i)] = ToUnsigned8(in[i]);
+        }
+        else {
+            // Input span this block's filter taps can reach
+            double x0 = n0 * step, x1 = (n0 + n - 1) * step;
+            int64_t first = max<int64_t>(0, (int64_t)ceil(x0 - halfWidth));
+            int64_t last = min<int64_t>((int64_t)fmt.frames - 1, (int64_t)floor(x1 + halfWidth));
+            in.resize((size_t)(last - first + 1));
+            DecodeMono(fmt, (uint64_t)first, in.size(), in.data());
+
+            for (size_t i = 0; i < n; i++) {
+                double x = (n0 + i) * step;
+                int64_t k0 = max(first, (int64_t)ceil(x - halfWidth));
+                int64_t k1 = min(last, (int64_t)floor(x + halfWidth));
+                double acc = 0.0;
+                for (int64_t k = k0; k <= k1; k++) {
+                    double u = fabs(x - (double)k) * cutoff * tableRes;
+                    int ui = (int)u;
+                    double f = u - ui;
+                    double h = table[ui] + (table[ui + 1] - table[ui]) * f;
+                    acc += in[(size_t)(k - first)] * h;
+                }
+                out.samples[(size_t)(n0 + i)] = ToUnsigned8((float)(acc * cutoff));
+            }
+        }
+        if (progress) progress->store((float)(n0 + n) / outCount);
+    }
+
+    out.ok = true;
+    return true;
+}
+
+void WavImporter::Start(const string& path, const vector<int>& rates) {
+    Cancel();
+    m_path = path;
+    m_cancel = false;
+    m_progress = 0.0f;
+    m_busy = true;
+    {
+        lock_guard<mutex> lock(m_mutex);
+        m_ready = false;
+    }
+
+    m_thread = thread([this, path, rates] {
+        WavImportResult result;
+        ImportWav(path, rates, result, &m_progress, &m_cancel);
+
+        lock_guard<mutex> lock(m_mutex);
+        m_result = move(result);
+        m_ready = true;
+        m_busy = false;
+    });
+}
+
+void WavImporter::Cancel() {
+    m_cancel = true;
+    if (m_thread.joinable()) m_thread.join();
+    m_busy = false;
+}
+
+bool WavImporter::Collect(WavImportResult& out) {
+    lock_guard<mutex> lock(m_mutex);
+    if (!m_ready) return false;
+    m_ready = false;
+    out = move(m_result);
+    return true;
+}
@@ -0,0 +1,51 @@
+﻿#pragma once
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct WavImportResult {
+    bool ok = false;
+    std::string error;
+    std::vector<uint8_t> samples; // Unsigned 8-bit mono
+    int sampleRate = 0;           // Rate of samples (one of the candidate rates)
+    int sourceRate = 0;
+};
+
+// Entry of rates closest to sourceRate, preferring an exact match so no resampling is needed
+int PickImportRate(int sourceRate, const std::vector<int>& rates);
+
+// Reads a PCM (8/16/24/32-bit) or float WAV through a memory-mapped view, chunk by chunk,
+// downmixes to mono and resamples block-wise with a windowed-sinc filter to the candidate
+// rate closest to the file's own. progress and cancel are optional.
+bool ImportWav(const std::string& path, const std::vector<int>& rates, WavImportResult& out,
+    std::atomic<float>* progress = nullptr, const std::atomic<bool>* cancel = nullptr);
+
+// Runs ImportWav on a worker thread so large files don't stall the UI
+class WavImporter {
+public:
+    ~WavImporter() { Cancel(); }
+
+    void Start(const std::string& path, const std::vector<int>& rates);
+    void Cancel();
+
+    bool Busy() const { return m_busy.load(); }
+    float Progress() const { return m_progress.load(); }
+    const std::string& Path() const { return m_path; }
+
+    // Hands over a finished import once; false while busy or when there's nothing new
+    bool Collect(WavImportResult& out);
+
+private:
+    std::string m_path;
+    std::thread m_thread;
+    std::atomic<bool> m_busy{ false };
+    std::atomic<bool> m_cancel{ false };
+    std::atomic<float> m_progress{ 0.0f };
+
+    std::mutex m_mutex;
+    bool m_ready = false;
+    WavImportResult m_result;
+};
@@ -0,0 +1,308 @@
+﻿#define _CRT_SECURE_NO_WARNINGS
+// Engine benchmark over the shipped presets: bytebeat-bench [options]
+#include "Bytebeat.h"
+#include "FlacEncoder.h"
+#include "Presets.h"
+#include "Renderer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <filesystem>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+namespace fs = filesystem;
+using Clock = chrono::steady_clock;
+
+static const int EXPORT_RATE = 44100;
+
+struct BenchResult {
+    string file;
+    string title;
+    int sampleRate = 0;
+    size_t codeBytes = 0;
+    bool compiled = false;
+    string error;
+
+    double compileMedianUs = 0.0;
+    double compileMinUs = 0.0;
+    double editMedianUs = 0.0;
+    double evalNsPerSample = 0.0;
+    double exportNsPerSample = 0.0;
+    double flacNsPerSample = 0.0;
+    double flacRatio = 0.0;
+};
+
+static void PrintUsage() {
+    printf(
+        "Usage: bytebeat-bench [options]\n"
+        "\n"
+        "Options:\n"
+        "  --presets DIR      Preset folder (default: bytebeat-player/Presets or Presets)\n"
+        "  --filter TEXT      Only run presets whose file name contains TEXT\n"
+        "  --seconds N        Formula seconds evaluated per preset (default: 10)\n"
+        "  --compile-reps N   Compile repetitions, median is reported (default: 20)\n"
+        "  --array N          Elements of the synthetic array literal compiled once the\n"
+        "                     presets are done (default: 1000000, 0 skips it)\n"
+        "  --label TEXT       Free-form tag stored in the JSON (e.g. commit hash)\n"
+        "  --json PATH        Write JSON to PATH instead of stdout\n"
+        "  -h, --help         Show this help\n");
+}
+
+static double Seconds(Clock::time_point a, Clock::time_point b) {
+    return chrono::duration<double>(b - a).count();
+}
+
+static string JsonEscape(const string& s) {
+    string out;
+    for (unsigned char c : s) {
+        switch (c) {
+        case '"': out += "\\\""; break;
+        case '\\': out += "\\\\"; break;
+        case '\n': out += "\\n"; break;
+        case '\r': out += "\\r"; break;
+        case '\t': out += "\\t"; break;
+        default:
+            if (c < 0x20) {
+                char buf[8];
+                snprintf(buf, sizeof(buf), "\\u%04x", c);
+                out += buf;
+            }
+            else out += (char)c;
+        }
+    }
+    return out;
+}
+
+static string CompilerName() {
+#if defined(__clang__)
+    return "clang " __clang_version__;
+#elif defined(__GNUC__)
+    return "gcc " __VERSION__;
+#elif defined(_MSC_VER)
+    return "msvc " + to_string(_MSC_VER);
+#else
+    return "unknown";
+#endif
+}
+
+static void RunPreset(const BytebeatPreset& preset, int seconds, int compileReps, BenchResult& r) {
+    r.title = preset.title;
+    r.sampleRate = preset.sampleRate > 0 ? preset.sampleRate : 8000;
+    r.codeBytes = preset.code.size();
+
+    ComplexEngine engine;
+    string err;
+    int errorPos = -1;
+
+    // Compile latency
+    vector<double> times;
+    for (int i = 0; i < compileReps; i++) {
+        auto a = Clock::now();
+        bool ok = engine.Compile(preset.code, err, errorPos);
+        auto b = Clock::now();
+        if (!ok) {
+            r.error = err.empty() ? "Empty program" : err;
+            return;
+        }
+        times.push_back(Seconds(a, b) * 1e6);
+    }
+    r.compiled = true;
+    sort(times.begin(), times.end());
+    r.compileMedianUs = times[times.size() / 2];
+    r.compileMinUs = times.front();
+
+    // Live edit: Recompile with the last segment changed, everything before it is reused
+    string edited = preset.code + "+0";
+    engine.Recompile(preset.code, err, errorPos);
+    times.clear();
+    for (int i = 0; i < compileReps; i++) {
+        auto a = Clock::now();
+        engine.Recompile(i % 2 ? preset.code : edited, err, errorPos);
+        times.push_back(Seconds(a, Clock::now()) * 1e6);
+    }
+    sort(times.begin(), times.end());
+    r.editMedianUs = times[times.size() / 2];
+
+    // Single-sample Eval throughput at the preset's own rate
+    uint32_t evalSamples = (uint32_t)max(1, seconds * r.sampleRate);
+    engine.Compile(preset.code, err, errorPos);
+    volatile int sink = 0;
+    auto a = Clock::now();
+    for (uint32_t t = 0; t < evalSamples; t++) sink += engine.Eval(t);
+    auto b = Clock::now();
+    (void)sink;
+    r.evalNsPerSample = Seconds(a, b) * 1e9 / evalSamples;
+
+    // Export path: resampled render to 44.1 kHz, then FLAC encode of that buffer
+    uint32_t exportSamples = (uint32_t)max(1, seconds * EXPORT_RATE);
+    vector<uint8_t> pcm(exportSamples);
+    engine.Compile(preset.code, err, errorPos);
+    a = Clock::now();
+    RenderSamples(engine, r.sampleRate, EXPORT_RATE, exportSamples, pcm.data());
+    b = Clock::now();
+    r.exportNsPerSample = Seconds(a, b) * 1e9 / exportSamples;
+
+    vector<uint8_t> flac;
+    a = Clock::now();
+    EncodeFlac(pcm.data(), pcm.size(), EXPORT_RATE, flac);
+    b = Clock::now();
+    r.flacNsPerSample = Seconds(a, b) * 1e9 / exportSamples;
+    r.flacRatio = flac.empty() ? 0.0 : (double)(pcm.size() + 44) / (double)flac.size();
+}
+
+// Compile latency of a wavetable-style program around one array literal of the given size
+static double ArrayCompileMedianMs(int elements, int reps) {
+    string code = "w=[";
+    char buf[32];
+    for (int i = 0; i < elements; i++) {
+        snprintf(buf, sizeof(buf), "%s%.4f", i ? "," : "", sin(i * 0.01) * 127.0);
+        code += buf;
+    }
+    code += "],w[t%" + to_string(max(1, elements)) + "]+128";
+
+    ComplexEngine engine;
+    string err;
+    int errorPos = -1;
+    vector<double> times;
+    for (int i = 0; i < reps; i++) {
+        auto a = Clock::now();
+        engine.Compile(code, err, errorPos);
+        times.push_back(Seconds(a, Clock::now()) * 1e3);
+    }
+    sort(times.begin(), times.end());
+    return times[times.size() / 2];
+}
+
+int main(int argc, char** argv) {
+    string presetDir;
+    string filter;
+    string label;
+    string jsonPath;
+    int seconds = 10;
+    int compileReps = 20;
+    int arrayElements = 1000000;
+
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "-h" || arg == "--help") {
+            PrintUsage();
+            return 0;
+        }
+        else if (arg == "--presets" && hasValue) presetDir = argv[++i];
+        else if (arg == "--filter" && hasValue) filter = argv[++i];
+        else if (arg == "--label" && hasValue) label = argv[++i];
+        else if (arg == "--json" && hasValue) jsonPath = argv[++i];
+        else if (arg == "--seconds" && hasValue) seconds = max(1, atoi(argv[++i]));
+        else if (arg == "--compile-reps" && hasValue) compileReps = max(1, atoi(argv[++i]));
+        else if (arg == "--array" && hasValue) arrayElements = max(0, atoi(argv[++i]));
+        else {
+            fprintf(stderr, "error: unknown or incomplete option '%s'\n", arg.c_str());
+            return 1;
+        }
+    }
+
+    if (presetDir.empty()) {
+        for (const char* candidate : { "bytebeat-player/Presets", "Presets", "../bytebeat-player/Presets" }) {
+            if (fs::is_directory(candidate)) {
+                presetDir = candidate;
+                break;
+            }
+        }
+    }
+    if (presetDir.empty() || !fs::is_directory(presetDir)) {
+        fprintf(stderr, "error: preset folder not found (use --presets DIR)\n");
+        return 1;
+    }
+
+    vector<fs::path> files;
+    for (const auto& entry : fs::directory_iterator(presetDir)) {
+        if (entry.path().extension() != ".txt") continue;
+        if (!filter.empty() && entry.path().filename().string().find(filter) == string::npos) continue;
+        files.push_back(entry.path());
+    }
+    sort(files.begin(), files.end());
+
+    vector<BenchResult> results;
+    for (const auto& path : files) {
+        BytebeatPreset preset;
+        BenchResult r;
+        r.file = path.filename().string();
+        if (!ParsePresetFile(path.string(), preset)) {
+            r.error = "Invalid preset file";
+            results.push_back(r);
+            continue;
+        }
+        fprintf(stderr, "%-32s ", r.file.c_str());
+        RunPreset(preset, seconds, compileReps, r);
+        if (r.compiled) {
+            fprintf(stderr, "compile %9.1f us | edit %8.1f us | eval %8.1f ns/sample (%7.1fx rt) | export %8.1f ns/sample | flac %6.1f ns/sample, %5.1f:1\n",
+                r.compileMedianUs, r.editMedianUs, r.evalNsPerSample, 1e9 / r.evalNsPerSample / r.sampleRate,
+                r.exportNsPerSample, r.flacNsPerSample, r.flacRatio);
+        }
+        else fprintf(stderr, "error: %s\n", r.error.c_str());
+        results.push_back(r);
+    }
+
+    double arrayMs = 0.0;
+    if (arrayElements > 0) {
+        arrayMs = ArrayCompileMedianMs(arrayElements, min(compileReps, 5));
+        fprintf(stderr, "%-32s compile %9.1f ms | %.1f ns/element\n", ("array literal x" + to_string(arrayElements)).c_str(),
+            arrayMs, arrayMs * 1e6 / arrayElements);
+    }
+
+    // JSON report
+    FILE* out = stdout;
+    if (!jsonPath.empty()) {
+        out = fopen(jsonPath.c_str(), "w");
+        if (!out) {
+            fprintf(stderr, "error: can't write '%s'\n", jsonPath.c_str());
+            return 1;
+        }
+    }
+
+    time_t now = time(nullptr);
+    char stamp[32];
+    strftime(stamp, sizeof(stamp), "%Y-%m-%dT%H:%M:%SZ", gmtime(&now));
+
+    fprintf(out, "{\n");
+    fprintf(out, "  \"schema\": 1,\n");
+    fprintf(out, "  \"label\": \"%s\",\n", JsonEscape(label).c_str());
+    fprintf(out, "  \"timestamp\": \"%s\",\n", stamp);
+    fprintf(out, "  \"machine\": { \"compiler\": \"%s\", \"hardware_threads\": %u, \"pointer_bits\": %d },\n",
+        JsonEscape(CompilerName()).c_str(), thread::hardware_concurrency(), (int)(sizeof(void*) * 8));
+    fprintf(out, "  \"config\": { \"seconds\": %d, \"compile_reps\": %d, \"export_rate\": %d },\n", seconds, compileReps, EXPORT_RATE);
+    if (arrayElements > 0) fprintf(out, "  \"array_literal\": { \"elements\": %d, \"compile_ms\": { \"median\": %.3f } },\n", arrayElements, arrayMs);
+    fprintf(out, "  \"presets\": [");
+    for (size_t i = 0; i < results.size(); i++) {
+        const BenchResult& r = results[i];
+        fprintf(out, "%s\n    {\n", i ? "," : "");
+        fprintf(out, "      \"file\": \"%s\",\n", JsonEscape(r.file).c_str());
+        fprintf(out, "      \"title\": \"%s\",\n", JsonEscape(r.title).c_str());
+        fprintf(out, "      \"rate\": %d,\n", r.sampleRate);
+        fprintf(out, "      \"code_bytes\": %zu,\n", r.codeBytes);
+        if (!r.compiled) {
+            fprintf(out, "      \"error\": \"%s\"\n    }", JsonEscape(r.error).c_str());
+            continue;
+        }
+        fprintf(out, "      \"compile_us\": { \"median\": %.3f, \"min\": %.3f },\n", r.compileMedianUs, r.compileMinUs);
+        fprintf(out, "      \"edit_us\": { \"median\": %.3f },\n", r.editMedianUs);
+        fprintf(out, "      \"eval\": { \"ns_per_sample\": %.3f, \"realtime\": %.2f },\n",
+            r.evalNsPerSample, 1e9 / r.evalNsPerSample / r.sampleRate);
+        fprintf(out, "      \"block\": null,\n");
+        fprintf(out, "      \"export\": { \"ns_per_sample\": %.3f, \"realtime\": %.2f },\n",
+            r.exportNsPerSample, 1e9 / r.exportNsPerSample / EXPORT_RATE);
+        fprintf(out, "      \"flac\": { \"ns_per_sample\": %.3f, \"ratio\": %.3f }\n", r.flacNsPerSample, r.flacRatio);
+        fprintf(out, "    }");
+    }
+    fprintf(out, "\n  ]\n}\n");
+    if (out != stdout) fclose(out);
+    return 0;
+}
@@ -0,0 +1,199 @@
+﻿#define _CRT_SECURE_NO_WARNINGS
+// FFT kernel microbenchmark and accuracy check: bytebeat-fftbench [options]
+#include "Fft.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <complex>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace std;
+using Clock = chrono::steady_clock;
+
+static const double TOLERANCE = 1e-4; // Max error relative to the largest bin
+
+struct FftResult {
+    string kind;
+    uint32_t size = 0;
+    double nsPerTransform = 0.0;
+    double mflops = 0.0;
+    double maxError = 0.0;
+};
+
+static void PrintUsage() {
+    printf(
+        "Usage: bytebeat-fftbench [options]\n"
+        "\n"
+        "Options:\n"
+        "  --min-log2 N       Smallest size 2^N (default: 6)\n"
+        "  --max-log2 N       Largest size 2^N (default: 14)\n"
+        "  --time-ms N        Time budget per size and kind (default: 200)\n"
+        "  --json PATH        Write JSON to PATH\n"
+        "  -h, --help         Show this help\n"
+        "\n"
+        "Exit code is 1 if any transform differs from the double-precision reference.\n");
+}
+
+// Recursive double-precision reference
+static void ReferenceFft(vector<complex<double>>& x) {
+    size_t n = x.size();
+    if (n < 2) return;
+    vector<complex<double>> even(n / 2), odd(n / 2);
+    for (size_t i = 0; i < n / 2; i++) {
+        even[i] = x[2 * i];
+        odd[i] = x[2 * i + 1];
+    }
+    ReferenceFft(even);
+    ReferenceFft(odd);
+    for (size_t k = 0; k < n / 2; k++) {
+        complex<double> w = polar(1.0, -2.0 * 3.14159265358979323846 * k / n) * odd[k];
+        x[k] = even[k] + w;
+        x[k + n / 2] = even[k] - w;
+    }
+}
+
+template <typename F>
+static double TimeNs(F&& transform, int budgetMs) {
+    // Calibrate a batch that takes ~1 ms, then repeat batches until the budget is spent
+    int batch = 1;
+    for (;;) {
+        auto a = Clock::now();
+        for (int i = 0; i < batch; i++) transform();
+        double ms = chrono::duration<double, milli>(Clock::now() - a).count();
+        if (ms >= 1.0 || batch >= (1 << 20)) break;
+        batch *= 2;
+    }
+
+    double best = 1e300;
+    auto start = Clock::now();
+    do {
+        auto a = Clock::now();
+        for (int i = 0; i < batch; i++) transform();
+        double ns = chrono::duration<double, nano>(Clock::now() - a).count() / batch;
+        best = min(best, ns);
+    } while (chrono::duration<double, milli>(Clock::now() - start).count() < budgetMs);
+    return best;
+}
+
+static FftResult BenchComplex(uint32_t n, int budgetMs, mt19937& rng) {
+    FftResult r;
+    r.kind = "complex";
+    r.size = n;
+
+    uniform_real_distribution<float> dist(-1.0f, 1.0f);
+    vector<float> srcRe(n), srcIm(n);
+    vector<complex<double>> ref(n);
+    for (uint32_t i = 0; i < n; i++) {
+        srcRe[i] = dist(rng);
+        srcIm[i] = dist(rng);
+        ref[i] = { srcRe[i], srcIm[i] };
+    }
+    vector<float> re = srcRe, im = srcIm;
+
+    ComplexFft fft(n);
+    fft.Forward(re.data(), im.data());
+    ReferenceFft(ref);
+    double peak = 0.0, err = 0.0;
+    for (uint32_t k = 0; k < n; k++) {
+        peak = max(peak, abs(ref[k]));
+        err = max(err, abs(ref[k] - complex<double>(re[k], im[k])));
+    }
+    r.maxError = err / max(peak, 1e-30);
+
+    // Transform is in place: restart from the input each run (the copy is included in the time)
+    r.nsPerTransform = TimeNs([&] {
+        copy(srcRe.begin(), srcRe.end(), re.begin());
+        copy(srcIm.begin(), srcIm.end(), im.begin());
+        fft.Forward(re.data(), im.data());
+    }, budgetMs);
+    r.mflops = 5.0 * n * log2((double)n) / r.nsPerTransform * 1e3;
+    return r;
+}
+
+static FftResult BenchReal(uint32_t n, int budgetMs, mt19937& rng) {
+    FftResult r;
+    r.kind = "real";
+    r.size = n;
+
+    uniform_real_distribution<float> dist(-1.0f, 1.0f);
+    vector<float> in(n), re(n / 2 + 1), im(n / 2 + 1);
+    vector<complex<double>> ref(n);
+    for (uint32_t i = 0; i < n; i++) {
+        in[i] = dist(rng);
+        ref[i] = in[i];
+    }
+
+    RealFft fft(n);
+    fft.Forward(in.data(), re.data(), im.data());
+    ReferenceFft(ref);
+    double peak = 0.0, err = 0.0;
+    for (uint32_t k = 0; k <= n / 2; k++) {
+        peak = max(peak, abs(ref[k]));
+        err = max(err, abs(ref[k] - complex<double>(re[k], im[k])));
+    }
+    r.maxError = err / max(peak, 1e-30);
+
+    r.nsPerTransform = TimeNs([&] { fft.Forward(in.data(), re.data(), im.data()); }, budgetMs);
+    r.mflops = 2.5 * n * log2((double)n) / r.nsPerTransform * 1e3;
+    return r;
+}
+
+int main(int argc, char** argv) {
+    int minLog2 = 6;
+    int maxLog2 = 14;
+    int budgetMs = 200;
+    string jsonPath;
+
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "-h" || arg == "--help") {
+            PrintUsage();
+            return 0;
+        }
+        else if (arg == "--min-log2" && hasValue) minLog2 = clamp(atoi(argv[++i]), 2, 20);
+        else if (arg == "--max-log2" && hasValue) maxLog2 = clamp(atoi(argv[++i]), 2, 20);
+        else if (arg == "--time-ms" && hasValue) budgetMs = max(0, atoi(argv[++i]));
+        else if (arg == "--json" && hasValue) jsonPath = argv[++i];
+        else {
+            fprintf(stderr, "error: unknown or incomplete option '%s'\n", arg.c_str());
+            return 1;
+        }
+    }
+
+    mt19937 rng(1234);
+    vector<FftResult> results;
+    bool ok = true;
+    for (int l = minLog2; l <= maxLog2; l++) {
+        for (int kind = 0; kind < 2; kind++) {
+            FftResult r = kind == 0 ? BenchComplex(1u << l, budgetMs, rng) : BenchReal(1u << l, budgetMs, rng);
+            bool pass = r.maxError <= TOLERANCE;
+            ok = ok && pass;
+            printf("%-7s %6u  %10.1f ns  %8.1f MFLOPS  err %.2e%s\n",
+                r.kind.c_str(), r.size, r.nsPerTransform, r.mflops, r.maxError, pass ? "" : "  FAIL");
+            results.push_back(r);
+        }
+    }
+
+    if (!jsonPath.empty()) {
+        FILE* out = fopen(jsonPath.c_str(), "w");
+        if (!out) {
+            fprintf(stderr, "error: can't write '%s'\n", jsonPath.c_str());
+            return 1;
+        }
+        fprintf(out, "{\n  \"schema\": 1,\n  \"results\": [");
+        for (size_t i = 0; i < results.size(); i++) {
+            const FftResult& r = results[i];
+            fprintf(out, "%s\n    { \"kind\": \"%s\", \"size\": %u, \"ns\": %.3f, \"mflops\": %.1f, \"max_error\": %.3e }",
+                i ? "," : "", r.kind.c_str(), r.size, r.nsPerTransform, r.mflops, r.maxError);
+        }
+        fprintf(out, "\n  ]\n}\n");
+        fclose(out);
+    }
+    return ok ? 0 : 1;
+}
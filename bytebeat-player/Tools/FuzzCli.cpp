@@ -0,0 +1,485 @@
+﻿#define _CRT_SECURE_NO_WARNINGS
+// Differential fuzzer: bytebeat-fuzz [options]
+//
+// 1. Generates random well-formed formulas over the supported grammar and checks
+//    that every engine path produces the same bytes as the reference
+//    BytebeatExpression interpreter over random t windows.
+// 2. Feeds adversarial inputs (huge strings/arrays, deep nesting, garbage) to
+//    Compile and flags crashes and super-linear compile time.
+#include "Bytebeat.h"
+#include "ProgramCache.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace std;
+using Clock = chrono::steady_clock;
+
+// --- Formula generator ---
+class FormulaGen {
+public:
+    explicit FormulaGen(uint64_t seed) : m_rng(seed) {}
+
+    int Range(int lo, int hi) { return uniform_int_distribution<int>(lo, hi)(m_rng); }
+    bool Chance(int percent) { return Range(0, 99) < percent; }
+    uint32_t Word() { return (uint32_t)m_rng(); }
+
+    // Single expression; inline assignments only target vars declared by the caller
+    string Expr(int depth) {
+        if (depth <= 0 || Chance(20)) return Leaf(depth);
+
+        switch (Range(0, 9)) {
+        case 0: return Paren(Expr(depth - 1) + " " + Pick(m_arith) + " " + Expr(depth - 1));
+        case 1: case 2: return Paren(Expr(depth - 1) + Pick(m_bit) + Expr(depth - 1));
+        case 3: return Paren(Expr(depth - 1) + Pick(m_cmp) + Expr(depth - 1));
+        case 4: return "(" + Expr(depth - 1) + "?" + Expr(depth - 1) + ":" + Expr(depth - 1) + ")";
+        case 5: return (Chance(50) ? "-" : "~") + Paren(Expr(depth - 1));
+        case 6: {
+            if (Chance(20)) return "pow(" + Expr(depth - 1) + "," + SmallNumber() + ")";
+            return Pick(m_funs) + "(" + Expr(depth - 1) + ")";
+        }
+        case 7: return StringLiteral() + ".charCodeAt(" + Expr(depth - 1) + ")";
+        case 8: return ArrayLiteral() + "[" + Expr(depth - 1) + "]";
+        default:
+            if (!m_vars.empty() && Chance(50)) return "(" + Pick(m_vars) + "=" + Expr(depth - 1) + ")";
+            return Paren("t" + Pick(m_bit) + Expr(depth - 1));
+        }
+    }
+
+    // Comma-separated program: "a=..., b=..., expr"
+    string Program(int depth, int statements) {
+        m_vars.clear();
+        string code;
+        for (int i = 0; i < statements; i++) {
+            string name = string(1, (char)('a' + i)) + (Chance(30) ? "_" + to_string(i) : "");
+            if (Chance(50)) code += name + "=" + Expr(depth) + ",";
+            else {
+                // Data-string sample playback, the importer's idiom
+                code += name + "=" + StringLiteral() + ",";
+                m_strings.push_back(name);
+            }
+            if (!m_strings.empty() && m_strings.back() == name) continue;
+            m_vars.push_back(name);
+        }
+        string tail = Expr(depth);
+        if (!m_strings.empty() && Chance(60)) {
+            const string& s = Pick(m_strings);
+            tail += "+" + s + ".charCodeAt(" + (Chance(50) ? "t" : Expr(depth - 1)) + "%" + s + ".length)";
+        }
+        m_strings.clear();
+        return code + tail;
+    }
+
+    void ClearVars() { m_vars.clear(); }
+
+    // @sample(N) / @chunk(N) handles that StringLiteral mixes in
+    void SetAssets(vector<string> handles) { m_assets = move(handles); }
+    // Registers a sample of random bytes (quotes and backslashes included) and returns its handle
+    string AddRandomSample(int length) {
+        vector<uint8_t> bytes(length);
+        for (auto& b : bytes) b = (uint8_t)Range(0, 255);
+        return "@sample(" + to_string(AddSample(move(bytes))) + ")";
+    }
+
+    string StringLiteral() {
+        if (!m_assets.empty() && Chance(15)) return Pick(m_assets);
+        int len = Range(1, 12);
+        char quote = Chance(50) ? '\'' : '"';
+        string s(1, quote);
+        for (int i = 0; i < len; i++) {
+            int kind = Range(0, 9);
+            if (kind < 5) s += (char)Range('A', 'z');
+            else if (kind < 9) {
+                char buf[8];
+                snprintf(buf, sizeof(buf), "\\x%02X", Range(0, 255));
+                s += buf;
+            }
+            else s += Chance(50) ? "\\n" : "\\\\";
+        }
+        return s + quote;
+    }
+
+private:
+    string Leaf(int depth) {
+        switch (Range(0, 7)) {
+        case 0: case 1: case 2: return "t";
+        case 3: return SmallNumber();
+        case 4: return to_string(Word() >> Range(0, 31));
+        case 5: return m_vars.empty() ? "t" : Pick(m_vars);
+        case 6: return StringLiteral() + ".length";
+        default: return depth > 0 ? ArrayLiteral() + ".length" : "t";
+        }
+    }
+
+    string SmallNumber() {
+        if (Chance(25)) return to_string(Range(0, 99)) + "." + to_string(Range(0, 99));
+        return to_string(Range(0, 32));
+    }
+
+    string ArrayLiteral() {
+        int len = Range(1, 8);
+        string s = "[";
+        for (int i = 0; i < len; i++) {
+            if (i) s += Chance(70) ? "," : " , ";
+            s += Chance(20) ? "-" + SmallNumber() : SmallNumber();
+        }
+        return s + "]";
+    }
+
+    string Paren(const string& e) { return Chance(70) ? "(" + e + ")" : e; }
+
+    const string& Pick(const vector<string>& v) { return v[Range(0, (int)v.size() - 1)]; }
+
+    mt19937_64 m_rng;
+    vector<string> m_vars;
+    vector<string> m_strings;
+    vector<string> m_assets;
+    const vector<string> m_arith = { "+", "-", "*", "/", "%" };
+    const vector<string> m_bit = { "&", "|", "^", "<<", ">>" };
+    const vector<string> m_cmp = { "<", ">", "<=", ">=", "==", "!=" };
+    const vector<string> m_funs = { "sin", "cos", "tan", "abs", "floor" };
+};
+
+// Whether code refers to @sample/@chunk handles outside string literals
+static bool HasAssetRefs(const string& code) {
+    string decoded;
+    for (size_t i = 0; i < code.size(); ) {
+        if (code[i] == '\'' || code[i] == '"') i = ParseStringLiteral(code, i, decoded);
+        else if (code[i++] == '@') return true;
+    }
+    return false;
+}
+
+// --- Engine paths under test ---
+struct EnginePath {
+    const char* name;
+    // Prepares engine for code; may compile other programs first to shake out stale state
+    function<bool(ComplexEngine&, const string&, string&)> compile;
+};
+
+static vector<EnginePath> BuildPaths(FormulaGen& gen) {
+    vector<EnginePath> paths;
+    paths.push_back({ "engine", [](ComplexEngine& e, const string& code, string& err) {
+        int pos = -1;
+        return e.Compile(code, err, pos);
+    } });
+    paths.push_back({ "recompile", [&gen](ComplexEngine& e, const string& code, string& err) {
+        int pos = -1;
+        string other = gen.Program(2, gen.Range(1, 3));
+        string ignored;
+        e.Compile(other, ignored, pos);
+        for (uint32_t t = 0; t < 64; t++) e.Eval(t);
+        return e.Compile(code, err, pos);
+    } });
+    // Background compile: built in another engine and swapped into a running one
+    paths.push_back({ "swap", [&gen](ComplexEngine& e, const string& code, string& err) {
+        int pos = -1;
+        string ignored;
+        e.Compile(gen.Program(2, gen.Range(1, 3)), ignored, pos);
+        for (uint32_t t = 0; t < 64; t++) e.Eval(t);
+        ComplexEngine worker;
+        if (!worker.Compile(code, err, pos)) return false;
+        e.Swap(worker);
+        return true;
+    } });
+    // Live edits: incremental Recompile over another program, and back from an edited last segment
+    paths.push_back({ "incremental", [&gen](ComplexEngine& e, const string& code, string& err) {
+        int pos = -1;
+        string ignored;
+        e.Recompile(gen.Program(2, gen.Range(1, 3)), ignored, pos);
+        for (uint32_t t = 0; t < 64; t++) e.Eval(t);
+        return e.Recompile(code, err, pos);
+    } });
+    paths.push_back({ "edit", [&gen](ComplexEngine& e, const string& code, string& err) {
+        int pos = -1;
+        string ignored;
+        size_t cut = code.rfind(',');
+        e.Recompile(cut == string::npos ? code + "+1" : code.substr(0, cut + 1) + gen.Expr(2), ignored, pos);
+        for (uint32_t t = 0; t < 64; t++) e.Eval(t);
+        return e.Recompile(code, err, pos);
+    } });
+    // Copy Formula and paste back: the expanded text must stand alone and compile to the same program
+    paths.push_back({ "clipboard", [](ComplexEngine& e, const string& code, string& err) {
+        int pos = -1;
+        string expanded = ExpandCode(code);
+        if (HasAssetRefs(expanded)) {
+            err = "expanded code still refers to session assets";
+            return false;
+        }
+        return e.Compile(CompressCode(expanded), err, pos);
+    } });
+    // Program cache hit: a program that already ran, stored and taken back must start fresh
+    paths.push_back({ "cache", [&gen](ComplexEngine& e, const string& code, string& err) {
+        int pos = -1;
+        string ignored;
+        ProgramCache cache;
+        auto first = make_unique<ComplexEngine>();
+        if (!first->Compile(code, err, pos)) return false;
+        for (uint32_t t = 0; t < 64; t++) first->Eval(t);
+        cache.Put(move(first));
+        auto other = make_unique<ComplexEngine>();
+        if (other->Compile(gen.Program(2, gen.Range(1, 3)), ignored, pos)) cache.Put(move(other));
+        auto hit = cache.Take(code);
+        if (!hit) {
+            err = "cache miss";
+            return false;
+        }
+        e.Swap(*hit);
+        return true;
+    } });
+    return paths;
+}
+
+struct Stats {
+    int cases = 0;
+    int mismatches = 0;
+    int compileErrors = 0;
+    int slow = 0;
+};
+
+static void Report(const char* kind, uint64_t seed, int iteration, const string& code, const string& detail) {
+    string shown = code.size() > 400 ? code.substr(0, 400) + "..." : code;
+    printf("%s (seed %llu, iteration %d): %s\n  code: %s\n", kind, (unsigned long long)seed, iteration, detail.c_str(), shown.c_str());
+}
+
+// The same program with "+0" after every ".length)": values don't change, but the sample lookup
+// idiom no longer matches, so the compiler can't fuse it
+static string Unfused(const string& code) {
+    string out;
+    size_t from = 0;
+    for (size_t at; (at = code.find(".length)", from)) != string::npos; from = at + 8) out += code.substr(from, at + 7 - from) + "+0)";
+    return out + code.substr(from);
+}
+
+// Single expressions: reference interpreter on the unfused spelling vs every engine path
+static void FuzzExpression(FormulaGen& gen, const vector<EnginePath>& paths, uint64_t seed, int iteration, int depth, Stats& st) {
+    gen.ClearVars();
+    string code = gen.Expr(depth);
+
+    BytebeatVM refVm;
+    BytebeatExpression ref;
+    string err;
+    int pos = -1;
+    if (!ref.Compile(Unfused(code), err, pos, refVm)) {
+        st.compileErrors++;
+        return;
+    }
+
+    uint32_t base = gen.Chance(50) ? (uint32_t)gen.Range(0, 1 << 20) : gen.Word();
+    const int window = 256;
+    vector<uint8_t> expected(window);
+    for (int i = 0; i < window; i++) expected[i] = (uint8_t)(ToInt32(ref.Eval(base + i)) & 0xFF);
+
+    for (const EnginePath& path : paths) {
+        ComplexEngine engine;
+        if (!path.compile(engine, code, err)) {
+            Report("COMPILE MISMATCH", seed, iteration, code, string(path.name) + " rejected code the reference accepts: " + err);
+            st.mismatches++;
+            continue;
+        }
+        for (int i = 0; i < window; i++) {
+            uint8_t got = (uint8_t)engine.Eval(base + i);
+            if (got != expected[i]) {
+                char buf[160];
+                snprintf(buf, sizeof(buf), "%s differs at t=%u: expected %d, got %d", path.name, base + i, expected[i], got);
+                Report("MISMATCH", seed, iteration, code, buf);
+                st.mismatches++;
+                break;
+            }
+        }
+    }
+    st.cases++;
+}
+
+// Multi-statement programs: the plain engine on the unfused spelling, running every instruction
+// each sample (nothing hoisted), is the reference for every path
+static void FuzzProgram(FormulaGen& gen, const vector<EnginePath>& paths, uint64_t seed, int iteration, int depth, Stats& st) {
+    string code = gen.Program(depth, gen.Range(1, 4));
+
+    ComplexEngine ref;
+    string err;
+    int pos = -1;
+    if (!ref.Compile(Unfused(code), err, pos)) {
+        st.compileErrors++;
+        return;
+    }
+    for (auto& ins : ref.instructions) ins.invariant = false;
+    ref.ResetVariables();
+    uint32_t base = gen.Chance(50) ? (uint32_t)gen.Range(0, 1 << 20) : gen.Word();
+    const int window = 256;
+    vector<uint8_t> expected(window);
+    for (int i = 0; i < window; i++) expected[i] = (uint8_t)ref.Eval(base + i);
+
+    for (size_t p = 0; p < paths.size(); p++) {
+        ComplexEngine engine;
+        if (!paths[p].compile(engine, code, err)) {
+            Report("COMPILE MISMATCH", seed, iteration, code, string(paths[p].name) + ": " + err);
+            st.mismatches++;
+            continue;
+        }
+        for (int i = 0; i < window; i++) {
+            uint8_t got = (uint8_t)engine.Eval(base + i);
+            if (got != expected[i]) {
+                char buf[160];
+                snprintf(buf, sizeof(buf), "%s differs at t=%u: expected %d, got %d", paths[p].name, base + i, expected[i], got);
+                Report("MISMATCH", seed, iteration, code, buf);
+                st.mismatches++;
+                break;
+            }
+        }
+    }
+    st.cases++;
+}
+
+// --- Adversarial compile inputs ---
+static double CompileSeconds(const string& code) {
+    ComplexEngine engine;
+    string err;
+    int pos = -1;
+    auto a = Clock::now();
+    engine.Compile(code, err, pos);
+    engine.Eval(1);
+    return chrono::duration<double>(Clock::now() - a).count();
+}
+
+static string HugeString(size_t n) {
+    string s = "d='";
+    static const char* hex = "0123456789ABCDEF";
+    for (size_t i = 0; i < n; i++) {
+        s += "\\x";
+        s += hex[(i * 7) & 15];
+        s += hex[(i * 13) & 15];
+    }
+    return s + "',d.charCodeAt(t%d.length)";
+}
+
+static string HugeArray(size_t n) {
+    string s = "a=[";
+    for (size_t i = 0; i < n; i++) s += (i ? "," : "") + to_string(i & 255);
+    return s + "],a[t%a.length]";
+}
+
+static string DeepParens(size_t n) { return string(n, '(') + "t" + string(n, ')'); }
+
+static string LongChain(size_t n) {
+    string s = "t";
+    for (size_t i = 0; i < n; i++) s += (i & 1) ? "^t>>3" : "+1";
+    return s;
+}
+
+static string ManyStatements(size_t n) {
+    string s;
+    for (size_t i = 0; i < n; i++) s += "v" + to_string(i % 97) + "=t>>" + to_string(i % 13) + ",";
+    return s + "t";
+}
+
+static void FuzzAdversarial(FormulaGen& gen, uint64_t seed, size_t baseSize, Stats& st) {
+    struct Shape {
+        const char* name;
+        function<string(size_t)> make;
+    };
+    const Shape shapes[] = {
+        { "huge string", HugeString },
+        { "huge array", HugeArray },
+        { "deep parens", DeepParens },
+        { "long chain", LongChain },
+        { "many statements", ManyStatements },
+    };
+
+    // Quadrupling the input should roughly quadruple compile time; quadratic growth would be x16,
+    // so flag anything above x10
+    for (const Shape& shape : shapes) {
+        size_t n = baseSize;
+        double tSmall = CompileSeconds(shape.make(n));
+        double tBig = CompileSeconds(shape.make(n * 4));
+        double ratio = tBig / max(tSmall, 1e-6);
+        bool slow = tBig > 0.05 && ratio > 10.0;
+        printf("%-16s n=%-8zu %9.3f ms   n=%-8zu %9.3f ms   x%.1f%s\n", shape.name, n, tSmall * 1e3, n * 4, tBig * 1e3, ratio,
+            slow ? "   <-- super-linear" : "");
+        if (slow) st.slow++;
+    }
+
+    // Garbage and truncated inputs must fail cleanly, never crash
+    for (int i = 0; i < 2000; i++) {
+        string code;
+        int len = gen.Range(0, 64);
+        if (gen.Chance(50)) {
+            for (int k = 0; k < len; k++) code += (char)gen.Range(1, 255);
+        }
+        else {
+            code = gen.Program(3, gen.Range(1, 3));
+            code = code.substr(0, gen.Range(0, (int)code.size()));
+        }
+        ComplexEngine engine;
+        string err;
+        int pos = -1;
+        if (engine.Compile(code, err, pos)) {
+            for (uint32_t t = 0; t < 16; t++) engine.Eval(gen.Word());
+        }
+    }
+    printf("garbage inputs: 2000 compiled/rejected without crashing (seed %llu)\n", (unsigned long long)seed);
+}
+
+int main(int argc, char** argv) {
+    uint64_t seed = (uint64_t)Clock::now().time_since_epoch().count();
+    int iterations = 2000;
+    int depth = 5;
+    size_t adversarialSize = 20000;
+    bool runDiff = true;
+    bool runAdversarial = true;
+
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "-h" || arg == "--help") {
+            printf(
+                "Usage: bytebeat-fuzz [options]\n"
+                "\n"
+                "Options:\n"
+                "  --seed N          RNG seed (default: time based, always printed)\n"
+                "  --iterations N    Differential cases (default: 2000)\n"
+                "  --depth N         Max expression depth (default: 5)\n"
+                "  --size N          Base size for adversarial inputs (default: 20000)\n"
+                "  --diff-only       Skip adversarial compile checks\n"
+                "  --adversarial-only  Skip differential checks\n");
+            return 0;
+        }
+        else if (arg == "--seed" && hasValue) seed = strtoull(argv[++i], nullptr, 10);
+        else if (arg == "--iterations" && hasValue) iterations = max(0, atoi(argv[++i]));
+        else if (arg == "--depth" && hasValue) depth = max(1, atoi(argv[++i]));
+        else if (arg == "--size" && hasValue) adversarialSize = (size_t)max(1, atoi(argv[++i]));
+        else if (arg == "--diff-only") runAdversarial = false;
+        else if (arg == "--adversarial-only") runDiff = false;
+        else {
+            fprintf(stderr, "error: unknown or incomplete option '%s'\n", arg.c_str());
+            return 1;
+        }
+    }
+
+    printf("bytebeat-fuzz seed %llu\n", (unsigned long long)seed);
+    FormulaGen gen(seed);
+    // A short sample expands inline, a long one comes back as a chunk; the chunk is a long literal
+    string chunkText;
+    for (int i = 0; i < 400; i++) chunkText += gen.StringLiteral();
+    for (char& c : chunkText) if (c == '\'' || c == '"') c = '_';
+    gen.SetAssets({ gen.AddRandomSample(gen.Range(1, 40)), gen.AddRandomSample(3000), CompressCode("'" + chunkText + "'") });
+    vector<EnginePath> paths = BuildPaths(gen);
+    Stats st;
+
+    if (runDiff) {
+        for (int i = 0; i < iterations; i++) {
+            if (i % 2 == 0) FuzzExpression(gen, paths, seed, i, depth, st);
+            else FuzzProgram(gen, paths, seed, i, depth - 1, st);
+        }
+        printf("differential: %d cases, %d mismatches, %d generated formulas rejected\n", st.cases, st.mismatches, st.compileErrors);
+    }
+    if (runAdversarial) FuzzAdversarial(gen, seed, adversarialSize, st);
+
+    return (st.mismatches || st.slow) ? 1 : 0;
+}
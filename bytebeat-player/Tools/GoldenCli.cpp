@@ -0,0 +1,328 @@
+﻿#define _CRT_SECURE_NO_WARNINGS
+// Golden-output regression check: bytebeat-golden [--update] [options]
+//
+// Renders the first N seconds of every preset plus the formula corpus through
+// ComplexEngine::Eval at the formula's own rate (t = 0, 1, 2, ...) and compares
+// a hash of the output bytes with the stored golden file. Each entry also keeps
+// hashes of 1024-sample blocks so a divergence can be located without the audio.
+// --dump/--against keep full renders on disk for an exact sample-level diff.
+#include "Bytebeat.h"
+#include "Presets.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace std;
+namespace fs = filesystem;
+
+static const uint32_t BLOCK_SIZE = 1024;
+
+struct GoldenCase {
+    string name;
+    string code;
+    int rate = 8000;
+};
+
+struct GoldenEntry {
+    int rate = 0;
+    uint32_t samples = 0;
+    uint64_t sourceHash = 0;
+    uint64_t outputHash = 0;
+    vector<uint32_t> blocks;
+};
+
+static uint64_t Fnv64(const void* data, size_t len) {
+    const uint8_t* p = (const uint8_t*)data;
+    uint64_t h = 14695981039346656037ull;
+    for (size_t i = 0; i < len; i++) {
+        h ^= p[i];
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+static uint32_t Fnv32(const void* data, size_t len) {
+    const uint8_t* p = (const uint8_t*)data;
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        h ^= p[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static void PrintUsage() {
+    printf(
+        "Usage: bytebeat-golden [options]\n"
+        "\n"
+        "Options:\n"
+        "  --update         Rewrite the golden file from the current engine\n"
+        "  --seconds N      Seconds rendered per formula when updating (default: 2)\n"
+        "  --presets DIR    Preset folder (default: <root>/Presets)\n"
+        "  --corpus FILE    Formula corpus (default: <root>/Tests/Golden/corpus.txt)\n"
+        "  --golden FILE    Golden hashes (default: <root>/Tests/Golden/golden.txt)\n"
+        "  --root DIR       bytebeat-player folder used for the defaults above\n"
+        "  --dump DIR       Also write each render as DIR/<name>.u8\n"
+        "  --against DIR    Diff renders sample by sample against a previous --dump\n"
+        "  --verbose        Print every case, not only failures\n"
+        "  -h, --help       Show this help\n");
+}
+
+static bool LoadCorpus(const string& path, vector<GoldenCase>& cases) {
+    ifstream file(path);
+    if (!file.is_open()) return false;
+
+    // "<rate> <formula>" per line, '#' starts a comment line
+    string line;
+    while (getline(file, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        size_t first = line.find_first_not_of(" \t");
+        if (first == string::npos || line[first] == '#') continue;
+
+        size_t sep = line.find_first_of(" \t", first);
+        if (sep == string::npos) continue;
+        GoldenCase c;
+        c.rate = atoi(line.substr(first, sep - first).c_str());
+        c.code = line.substr(line.find_first_not_of(" \t", sep));
+        if (c.rate <= 0 || c.code.empty()) continue;
+
+        char name[32];
+        snprintf(name, sizeof(name), "corpus:%016llx", (unsigned long long)Fnv64(c.code.data(), c.code.size()));
+        c.name = name;
+        cases.push_back(c);
+    }
+    return true;
+}
+
+static bool LoadGolden(const string& path, map<string, GoldenEntry>& golden) {
+    ifstream file(path);
+    if (!file.is_open()) return false;
+
+    // "<name> <rate> <samples> <sourceHash> <outputHash> <block,block,...>"
+    string line;
+    while (getline(file, line)) {
+        if (line.empty() || line[0] == '#') continue;
+        istringstream ss(line);
+        string name, src, out, blocks;
+        GoldenEntry e;
+        if (!(ss >> name >> e.rate >> e.samples >> src >> out)) continue;
+        ss >> blocks;
+        e.sourceHash = strtoull(src.c_str(), nullptr, 16);
+        e.outputHash = strtoull(out.c_str(), nullptr, 16);
+        stringstream bs(blocks);
+        string item;
+        while (getline(bs, item, ',')) e.blocks.push_back((uint32_t)strtoul(item.c_str(), nullptr, 16));
+        golden[name] = e;
+    }
+    return true;
+}
+
+static bool Render(const GoldenCase& c, uint32_t samples, vector<uint8_t>& out, string& err) {
+    ComplexEngine engine;
+    int errorPos = -1;
+    if (!engine.Compile(c.code, err, errorPos)) {
+        if (err.empty()) err = "Empty program";
+        return false;
+    }
+    out.resize(samples);
+    for (uint32_t t = 0; t < samples; t++) out[t] = (uint8_t)engine.Eval(t);
+    return true;
+}
+
+static GoldenEntry Summarize(const GoldenCase& c, const vector<uint8_t>& pcm) {
+    GoldenEntry e;
+    e.rate = c.rate;
+    e.samples = (uint32_t)pcm.size();
+    e.sourceHash = Fnv64(c.code.data(), c.code.size());
+    e.outputHash = Fnv64(pcm.data(), pcm.size());
+    for (size_t i = 0; i < pcm.size(); i += BLOCK_SIZE) {
+        e.blocks.push_back(Fnv32(pcm.data() + i, min((size_t)BLOCK_SIZE, pcm.size() - i)));
+    }
+    return e;
+}
+
+static string DumpPath(const string& dir, const string& name) {
+    string file = name;
+    replace(file.begin(), file.end(), ':', '_');
+    return (fs::path(dir) / (file + ".u8")).string();
+}
+
+int main(int argc, char** argv) {
+    string root, presetDir, corpusPath, goldenPath, dumpDir, againstDir;
+    bool update = false;
+    bool verbose = false;
+    int seconds = 2;
+
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "-h" || arg == "--help") {
+            PrintUsage();
+            return 0;
+        }
+        else if (arg == "--update") update = true;
+        else if (arg == "--verbose") verbose = true;
+        else if (arg == "--seconds" && hasValue) seconds = max(1, atoi(argv[++i]));
+        else if (arg == "--root" && hasValue) root = argv[++i];
+        else if (arg == "--presets" && hasValue) presetDir = argv[++i];
+        else if (arg == "--corpus" && hasValue) corpusPath = argv[++i];
+        else if (arg == "--golden" && hasValue) goldenPath = argv[++i];
+        else if (arg == "--dump" && hasValue) dumpDir = argv[++i];
+        else if (arg == "--against" && hasValue) againstDir = argv[++i];
+        else {
+            fprintf(stderr, "error: unknown or incomplete option '%s'\n", arg.c_str());
+            return 1;
+        }
+    }
+
+    if (root.empty()) {
+        for (const char* candidate : { "bytebeat-player", ".", ".." }) {
+            if (fs::is_directory(fs::path(candidate) / "Presets")) {
+                root = candidate;
+                break;
+            }
+        }
+    }
+    if (presetDir.empty()) presetDir = (fs::path(root) / "Presets").string();
+    if (corpusPath.empty()) corpusPath = (fs::path(root) / "Tests" / "Golden" / "corpus.txt").string();
+    if (goldenPath.empty()) goldenPath = (fs::path(root) / "Tests" / "Golden" / "golden.txt").string();
+
+    // Collect cases: presets first (sorted by file name), then the corpus
+    vector<GoldenCase> cases;
+    if (fs::is_directory(presetDir)) {
+        vector<fs::path> files;
+        for (const auto& entry : fs::directory_iterator(presetDir)) {
+            if (entry.path().extension() == ".txt") files.push_back(entry.path());
+        }
+        sort(files.begin(), files.end());
+        for (const auto& path : files) {
+            BytebeatPreset preset;
+            if (!ParsePresetFile(path.string(), preset)) continue;
+            GoldenCase c;
+            c.name = "preset:" + path.filename().string();
+            c.code = preset.code;
+            c.rate = preset.sampleRate > 0 ? preset.sampleRate : 8000;
+            cases.push_back(c);
+        }
+    }
+    else fprintf(stderr, "warning: preset folder '%s' not found\n", presetDir.c_str());
+
+    if (!LoadCorpus(corpusPath, cases)) fprintf(stderr, "warning: corpus '%s' not found\n", corpusPath.c_str());
+    if (cases.empty()) {
+        fprintf(stderr, "error: nothing to render\n");
+        return 1;
+    }
+    if (!dumpDir.empty()) fs::create_directories(dumpDir);
+
+    map<string, GoldenEntry> golden;
+    if (!update && !LoadGolden(goldenPath, golden)) {
+        fprintf(stderr, "error: golden file '%s' not found (run with --update first)\n", goldenPath.c_str());
+        return 1;
+    }
+
+    vector<pair<string, GoldenEntry>> updated;
+    int failures = 0;
+    int passed = 0;
+
+    for (const GoldenCase& c : cases) {
+        uint32_t samples = (uint32_t)seconds * (uint32_t)c.rate;
+        auto it = golden.find(c.name);
+        if (!update) {
+            if (it == golden.end()) {
+                printf("MISSING  %s (no golden entry, run --update)\n", c.name.c_str());
+                failures++;
+                continue;
+            }
+            samples = it->second.samples;
+        }
+
+        vector<uint8_t> pcm;
+        string err;
+        if (!Render(c, samples, pcm, err)) {
+            printf("ERROR    %s: compile failed: %s\n", c.name.c_str(), err.c_str());
+            failures++;
+            continue;
+        }
+        GoldenEntry now = Summarize(c, pcm);
+
+        if (!dumpDir.empty()) {
+            ofstream(DumpPath(dumpDir, c.name), ios::binary).write((const char*)pcm.data(), pcm.size());
+        }
+
+        // Exact diff against a previous dump, independent of the golden hashes
+        if (!againstDir.empty()) {
+            ifstream ref(DumpPath(againstDir, c.name), ios::binary);
+            vector<uint8_t> refPcm((istreambuf_iterator<char>(ref)), istreambuf_iterator<char>());
+            size_t n = min(refPcm.size(), pcm.size());
+            size_t diff = 0;
+            while (diff < n && refPcm[diff] == pcm[diff]) diff++;
+            if (!ref.is_open()) printf("NODUMP   %s\n", c.name.c_str());
+            else if (diff < n || refPcm.size() != pcm.size()) {
+                if (diff < n) {
+                    printf("DIFF     %s: first differing sample %zu (t=%zu): expected %d, got %d\n",
+                        c.name.c_str(), diff, diff, refPcm[diff], pcm[diff]);
+                }
+                else printf("DIFF     %s: length %zu vs %zu\n", c.name.c_str(), refPcm.size(), pcm.size());
+                failures++;
+            }
+        }
+
+        if (update) {
+            updated.emplace_back(c.name, now);
+            if (verbose) printf("UPDATED  %s %016llx\n", c.name.c_str(), (unsigned long long)now.outputHash);
+            continue;
+        }
+
+        const GoldenEntry& ref = it->second;
+        if (ref.sourceHash != now.sourceHash) {
+            printf("CHANGED  %s: source differs from the golden entry, run --update\n", c.name.c_str());
+            failures++;
+        }
+        else if (ref.outputHash != now.outputHash) {
+            size_t block = 0;
+            while (block < ref.blocks.size() && block < now.blocks.size() && ref.blocks[block] == now.blocks[block]) block++;
+            uint32_t first = (uint32_t)(block * BLOCK_SIZE);
+            uint32_t last = min(first + BLOCK_SIZE, samples) - 1;
+            printf("DIVERGED %s: first differing block covers samples %u..%u (t=%u..%u at %d Hz, %.3f s)\n",
+                c.name.c_str(), first, last, first, last, c.rate, (double)first / c.rate);
+            printf("         use --dump before the change and --against after it for the exact sample\n");
+            failures++;
+        }
+        else {
+            passed++;
+            if (verbose) printf("OK       %s\n", c.name.c_str());
+        }
+    }
+
+    if (update) {
+        fs::create_directories(fs::path(goldenPath).parent_path());
+        ofstream out(goldenPath);
+        out << "# bytebeat-golden: <name> <rate> <samples> <source fnv64> <output fnv64> <fnv32 per " << BLOCK_SIZE << " samples>\n";
+        out << "# Regenerate with: bytebeat-golden --update --seconds " << seconds << "\n";
+        for (const auto& entry : updated) {
+            const GoldenEntry& e = entry.second;
+            char head[128];
+            snprintf(head, sizeof(head), " %d %u %016llx %016llx ", e.rate, e.samples,
+                (unsigned long long)e.sourceHash, (unsigned long long)e.outputHash);
+            out << entry.first << head;
+            for (size_t i = 0; i < e.blocks.size(); i++) {
+                char b[16];
+                snprintf(b, sizeof(b), "%s%08x", i ? "," : "", e.blocks[i]);
+                out << b;
+            }
+            out << "\n";
+        }
+        printf("Wrote %zu entries to %s\n", updated.size(), goldenPath.c_str());
+        return failures ? 1 : 0;
+    }
+
+    printf("%d passed, %d failed\n", passed, failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,175 @@
+﻿#define _CRT_SECURE_NO_WARNINGS
+// Headless renderer: bytebeat-render [options] <formula | preset.txt>
+#include "Bytebeat.h"
+#include "FlacEncoder.h"
+#include "Presets.h"
+#include "Renderer.h"
+
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+using namespace std;
+namespace fs = filesystem;
+
+static void PrintUsage() {
+    printf(
+        "Usage: bytebeat-render [options] <formula | preset.txt>\n"
+        "\n"
+        "Options:\n"
+        "  --rate N       Formula sample rate in Hz (default: preset Rate, else 8000)\n"
+        "  --seconds N    Duration to render (default: 30)\n"
+        "  --out PATH     Output file, .wav or .flac (default: output.wav)\n"
+        "  --out-rate N   Output sample rate, 0 = same as --rate (default: 44100)\n"
+        "  --threads N    FLAC encoder threads, 0 = all cores (default: 0)\n"
+        "  --quiet        Only print errors\n"
+        "  -h, --help     Show this help\n");
+}
+
+static bool EndsWith(const string& s, const string& suffix) {
+    if (s.size() < suffix.size()) return false;
+    for (size_t i = 0; i < suffix.size(); i++) {
+        if (tolower((unsigned char)s[s.size() - suffix.size() + i]) != suffix[i]) return false;
+    }
+    return true;
+}
+
+static bool ParseInt(const char* text, long long minVal, long long& out) {
+    char* end = nullptr;
+    long long v = strtoll(text, &end, 10);
+    if (!end || *end != '\0' || v < minVal) return false;
+    out = v;
+    return true;
+}
+
+int main(int argc, char** argv) {
+    long long rate = -1;
+    long long seconds = 30;
+    long long outRate = 44100;
+    long long threads = 0;
+    bool quiet = false;
+    string outPath = "output.wav";
+    string source;
+
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        auto needValue = [&](long long minVal, long long& dst) {
+            if (i + 1 >= argc || !ParseInt(argv[i + 1], minVal, dst)) {
+                fprintf(stderr, "error: %s expects an integer >= %lld\n", arg.c_str(), minVal);
+                exit(1);
+            }
+            i++;
+        };
+
+        if (arg == "-h" || arg == "--help") {
+            PrintUsage();
+            return 0;
+        }
+        else if (arg == "--rate") needValue(1, rate);
+        else if (arg == "--seconds") needValue(1, seconds);
+        else if (arg == "--out-rate") needValue(0, outRate);
+        else if (arg == "--threads") needValue(0, threads);
+        else if (arg == "--quiet") quiet = true;
+        else if (arg == "--out") {
+            if (i + 1 >= argc) {
+                fprintf(stderr, "error: --out expects a path\n");
+                return 1;
+            }
+            outPath = argv[++i];
+        }
+        else if (arg.size() > 2 && arg.compare(0, 2, "--") == 0) {
+            fprintf(stderr, "error: unknown option '%s'\n", arg.c_str());
+            return 1;
+        }
+        else if (source.empty()) source = arg;
+        else {
+            fprintf(stderr, "error: more than one formula given\n");
+            return 1;
+        }
+    }
+
+    if (source.empty()) {
+        PrintUsage();
+        return 1;
+    }
+
+    // Formula or preset file
+    string code = source;
+    string title;
+    if (EndsWith(source, ".txt") && fs::is_regular_file(source)) {
+        BytebeatPreset preset;
+        if (!ParsePresetFile(source, preset)) {
+            fprintf(stderr, "error: '%s' is not a valid preset (missing Title or Code)\n", source.c_str());
+            return 3;
+        }
+        code = preset.code;
+        title = preset.title;
+        if (rate < 0) rate = preset.sampleRate;
+    }
+    if (rate < 0) rate = 8000;
+    if (outRate == 0) outRate = rate;
+
+    bool flac = EndsWith(outPath, ".flac");
+    if (!flac && !EndsWith(outPath, ".wav")) {
+        fprintf(stderr, "error: output must end in .wav or .flac\n");
+        return 1;
+    }
+    if (outRate > 655350) {
+        fprintf(stderr, "error: unsupported output rate %lld\n", outRate);
+        return 1;
+    }
+    unsigned long long total = (unsigned long long)seconds * (unsigned long long)outRate;
+    if (total > 0xFFFFFFFFull - 64) {
+        fprintf(stderr, "error: %lld s at %lld Hz exceeds the 4 GiB sample limit\n", seconds, outRate);
+        return 1;
+    }
+
+    ComplexEngine engine;
+    string err;
+    int errorPos = -1;
+    if (!engine.Compile(code, err, errorPos)) {
+        if (err.empty()) err = "Empty program";
+        fprintf(stderr, "compile error: %s", err.c_str());
+        if (errorPos >= 0) fprintf(stderr, " (at offset %d)", errorPos);
+        fprintf(stderr, "\n");
+        return 2;
+    }
+
+    if (!quiet) {
+        if (!title.empty()) printf("Preset:  %s\n", title.c_str());
+        printf("Render:  %lld s, t at %lld Hz, output %lld Hz -> %s\n", seconds, rate, outRate, outPath.c_str());
+    }
+
+    auto t0 = chrono::steady_clock::now();
+    vector<uint8_t> samples((size_t)total);
+    RenderSamples(engine, (int)rate, (int)outRate, (uint32_t)total, samples.data());
+    auto t1 = chrono::steady_clock::now();
+
+    bool ok;
+    if (flac) {
+        FlacEncoderOptions opt;
+        opt.threads = (int)threads;
+        ok = WriteFlacFile(outPath, samples.data(), samples.size(), (int)outRate, opt);
+    }
+    else ok = WriteWavFile(outPath, samples.data(), samples.size(), (int)outRate);
+    auto t2 = chrono::steady_clock::now();
+
+    if (!ok) {
+        fprintf(stderr, "error: failed to write '%s'\n", outPath.c_str());
+        return 3;
+    }
+
+    if (!quiet) {
+        double renderSec = chrono::duration<double>(t1 - t0).count();
+        double writeSec = chrono::duration<double>(t2 - t1).count();
+        printf("Done:    render %.3f s (%.1fx realtime), write %.3f s, %llu bytes\n",
+            renderSec, renderSec > 0 ? seconds / renderSec : 0.0, writeSec,
+            (unsigned long long)fs::file_size(outPath));
+    }
+    return 0;
+}
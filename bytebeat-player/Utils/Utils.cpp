@@ -1,10 +1,14 @@
 ﻿#define _CRT_SECURE_NO_WARNINGS
 #include "Utils.h"
 #include "GlobalState.h"
+#include "FlacEncoder.h"
+#include "Renderer.h"
+#include "Samples.h"
 #include "imgui.h"
 #include "raylib.h"
 #include "TextEditor.h"
 
+#include <algorithm>
 #include <cstdio>
 #include <ctime>
 #include <string>
@@ -66,70 +70,62 @@ void UpdateErrorMarkers() {
     state.editor.SetErrorMarkers(markers);
 }
 
-void ExportToWav() {
-    if (!state.valid) return;
-
+// Resolves "Exports/<name><ext>" from the filename box, swapping any known audio extension
+static string PrepareExportPath(const string& ext) {
     if (strlen(state.exportFilenameBuf) == 0) {
-        strncpy(state.exportFilenameBuf, "output.wav", sizeof(state.exportFilenameBuf) - 1);
+        strncpy(state.exportFilenameBuf, ("output" + ext).c_str(), sizeof(state.exportFilenameBuf) - 1);
     }
-    
-    // Ensure .wav extension
+
     string fileName = state.exportFilenameBuf;
-    if (fileName.length() < 4 || fileName.substr(fileName.length() - 4) != ".wav") {
-        fileName += ".wav";
+    for (const char* known : { ".wav", ".flac" }) {
+        size_t len = strlen(known);
+        if (fileName.length() > len && fileName.substr(fileName.length() - len) == known) {
+            fileName.erase(fileName.length() - len);
+            break;
+        }
     }
+    fileName += ext;
 
     // Create Exports folder if not exists
     if (!fs::exists("Exports")) {
         fs::create_directory("Exports");
     }
+    return "Exports/" + fileName;
+}
+
+// Renders the export duration at exportRate as unsigned 8-bit samples
+static void RenderExport(int exportRate, vector<uint8_t>& out) {
+    uint32_t seconds = (state.exportDuration > 0) ? state.exportDuration : 30;
+    out.resize(seconds * exportRate);
+    RenderSamples(state.engine, state.rates[state.rateIdx], exportRate, (uint32_t)out.size(), out.data(), &state.exportProgress);
+}
 
-    state.fileName = "Exports/" + fileName;
+void ExportToWav() {
+    if (!state.valid) return;
+
+    state.fileName = PrepareExportPath(".wav");
 
     const int exportRate = 44100;
-    int targetRate = state.rates[state.rateIdx];
-    uint32_t seconds = (state.exportDuration > 0) ? state.exportDuration : 30;
-    uint32_t totalSamples = seconds * exportRate;
-
-    FILE* f = fopen(state.fileName.c_str(), "wb");
-    if (!f) return;
-
-    // HEADER WAV
-    fwrite("RIFF", 1, 4, f);
-    uint32_t chunkSize = 36 + totalSamples; fwrite(&chunkSize, 4, 1, f);
-    fwrite("WAVE", 1, 4, f);
-    fwrite("fmt ", 1, 4, f);
-    uint32_t s1 = 16; fwrite(&s1, 4, 1, f);
-    uint16_t alg = 1; fwrite(&alg, 2, 1, f);
-    uint16_t ch = 1; fwrite(&ch, 2, 1, f);
-    fwrite(&exportRate, 4, 1, f);
-    uint32_t br = exportRate; fwrite(&br, 4, 1, f);
-    uint16_t ba = 1; fwrite(&ba, 2, 1, f);
-    uint16_t bps = 8; fwrite(&bps, 2, 1, f);
-    fwrite("data", 1, 4, f);
-    fwrite(&totalSamples, 4, 1, f);
-
-    // DATA
-    double tAccumLocal = 0.0;
-    uint32_t tLocal = 0;
-    double tInc = (double)targetRate / (double)exportRate;
-
-    for (uint32_t i = 0; i < totalSamples; i++) {
-        int v = state.engine.Eval(tLocal);
-        fputc((unsigned char)(v & 0xFF), f);
-
-        tAccumLocal += tInc;
-        if (tAccumLocal >= 1.0) {
-            uint32_t steps = (uint32_t)tAccumLocal;
-            tLocal += steps;
-            tAccumLocal -= (double)steps;
-        }
-        if (i % 5000 == 0) state.exportProgress = (float)i / totalSamples;
-    }
+    vector<uint8_t> samples;
+    RenderExport(exportRate, samples);
 
-    fclose(f);
+    bool ok = WriteWavFile(state.fileName, samples.data(), samples.size(), exportRate);
     state.exportProgress = -1.0f;
-    state.successMsgTimer = 3.0f;
+    if (ok) state.successMsgTimer = 3.0f;
+}
+
+void ExportToFlac() {
+    if (!state.valid) return;
+
+    state.fileName = PrepareExportPath(".flac");
+
+    const int exportRate = 44100;
+    vector<uint8_t> samples;
+    RenderExport(exportRate, samples);
+
+    bool ok = WriteFlacFile(state.fileName, samples.data(), samples.size(), exportRate);
+    state.exportProgress = -1.0f;
+    if (ok) state.successMsgTimer = 3.0f;
 }
 
 void LoadCodeToEditor(string fullCode) {
@@ -137,36 +133,24 @@ void LoadCodeToEditor(string fullCode) {
     state.editor.SetText(viewCode);
     strncpy(state.inputBuf, viewCode.c_str(), sizeof(state.inputBuf) - 1);
 
-    state.errorMsg.clear();
-    state.valid = state.engine.Compile(fullCode, state.errorMsg, state.errorPos);
+    // Loading replaces whatever was being typed; presets seen before come from the program cache
+    CompileResult compiled;
+    state.compiler.CompileNow(viewCode, compiled);
+    if (compiled.valid) {
+        state.engine.Swap(*compiled.engine);
+        state.compiledCode = viewCode;
+    }
+    state.compiler.Recycle(move(compiled.engine));
+    state.valid = compiled.valid;
+    state.errorMsg = compiled.error;
+    state.errorPos = compiled.errorPos;
 
     UpdateErrorMarkers();
     state.t = 0;
     state.tAccum = 0.0;
-    state.rateIdx = 4;
     state.playing = true;
 }
 
-// Helper function to remove white characters (CR, LF, Spaces)
-static string TrimRight(string s) {
-    s.erase(find_if(s.rbegin(), s.rend(), [](unsigned char ch) {
-        return !isspace(ch);
-        }).base(), s.end()
-    );
-    return s;
-}
-
-// Helper function to remove BOM (Byte Order Mark)
-static string RemoveBOM(string s) {
-    if (s.size() >= 3 && 
-        (unsigned char)s[0] == 0xEF && 
-        (unsigned char)s[1] == 0xBB && 
-        (unsigned char)s[2] == 0xBF) {
-        return s.substr(3);
-    }
-    return s;
-}
-
 void LoadPresets(const string& folderPath) {
     g_presets.clear();
 
@@ -181,48 +165,8 @@ void LoadPresets(const string& folderPath) {
         transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
 
         if (ext == ".txt") {
-            ifstream file(entry.path());
-            if (!file.is_open()) continue;
-
             BytebeatPreset preset;
-            string line;
-            string accumulatedCode;
-            bool readingCode = false;
-            bool firstLine = true;
-
-            while (getline(file, line)) {
-                // Remove trash from endline
-                line = TrimRight(line);
-
-                // BOM fix for first line
-                if (firstLine) {
-                    line = RemoveBOM(line);
-                    firstLine = false;
-                }
-
-                if (readingCode) {
-                    accumulatedCode += line + "\n";
-                    continue;
-                }
-                if (line.find("Code=") == 0) {
-                    readingCode = true;
-                    if (line.length() > 5) accumulatedCode += line.substr(5) + "\n";
-                }
-                else if (line.find("Title=") == 0) preset.title = line.substr(6);
-                else if (line.find("Rate=") == 0) {
-                    try {
-                        preset.sampleRate = stoi(line.substr(5));
-                    }
-                    catch (...) { 
-                        preset.sampleRate = 8000; 
-                    }
-                }
-            }
-
-            preset.code = accumulatedCode;
-            if (!preset.code.empty() && preset.code.back() == '\n') preset.code.pop_back();
-
-            if (!preset.title.empty() && !preset.code.empty()) {
+            if (ParsePresetFile(entry.path().string(), preset)) {
                 g_presets.push_back(preset);
                 TraceLog(LOG_INFO, "PRESETS: Loaded '%s'", preset.title.c_str());
             }
@@ -231,15 +175,54 @@ void LoadPresets(const string& folderPath) {
     }
 }
 
-uint32_t FindTrigger(uint32_t currentT) {
-    const int searchRange = 1024;
-    for (uint32_t i = 0; i < searchRange; i++) {
-        int valNow = state.engine.Eval(currentT + i);
-        int valNext = state.engine.Eval(currentT + i + 1);
+void DecimateColumns(const uint8_t* samples, uint32_t count, int columns, uint8_t* lo, uint8_t* hi) {
+    if (count == 0 || columns <= 0) return;
+    uint8_t prev = samples[0];
+    for (int c = 0; c < columns; c++) {
+        uint32_t i0 = (uint32_t)((uint64_t)c * count / columns);
+        uint32_t i1 = max(i0 + 1, (uint32_t)((uint64_t)(c + 1) * count / columns));
+        uint8_t l = prev, h = prev;
+        for (uint32_t i = i0; i < i1; i++) {
+            l = min(l, samples[i]);
+            h = max(h, samples[i]);
+        }
+        lo[c] = l;
+        hi[c] = h;
+        prev = samples[i1 - 1];
+    }
+}
+
+void DrawColumnRanges(ImDrawList* dl, ImVec2 pos, ImVec2 size, const uint8_t* lo, const uint8_t* hi,
+    int columns, float thickness, ImU32 color) {
+    if (columns <= 0) return;
 
-        if (valNow <= 2 && valNext > 2) return currentT + i;
+    static ImU32 hues[256];
+    static bool huesReady = false;
+    if (!huesReady) {
+        for (int i = 0; i < 256; i++) hues[i] = ImColor::HSV(i / 256.0f, 0.8f, 1.0f);
+        huesReady = true;
+    }
+
+    int visible = 0;
+    for (int c = 0; c < columns; c++) visible += lo[c] <= hi[c];
+
+    // Reserved in chunks so 16-bit indices never overflow
+    const int chunk = 4096;
+    float colW = size.x / columns;
+    float half = thickness * 0.5f;
+    int written = 0;
+    for (int c = 0; c < columns; c++) {
+        if (lo[c] > hi[c]) continue;
+        if (written % chunk == 0) {
+            int n = min(chunk, visible - written);
+            dl->PrimReserve(n * 6, n * 4);
+        }
+        float x = pos.x + c * colW;
+        float yTop = pos.y + size.y - hi[c] / 255.0f * size.y - half;
+        float yBottom = pos.y + size.y - lo[c] / 255.0f * size.y + half;
+        dl->PrimRect({ x, yTop }, { x + max(colW, 1.0f), yBottom }, color ? color : hues[c * 256 / columns]);
+        written++;
     }
-    return currentT;
 }
 
 string FormatCode(const string& code, int maxChars) {
@@ -295,83 +278,25 @@ string FormatCode(const string& code, int maxChars) {
     return out.str();
 }
 
-string ConvertWavToBytebeat(const char* filePath) {
-    Wave wave = LoadWave(filePath);
-    if (wave.data == nullptr) TraceLog(LOG_ERROR, "Failed to load .wav file");
-
-    // Format audio (32000Hz/8-bit/mono)
-    WaveFormat(&wave, 32000, 8, 1);
-
-    // Generate HEX
-    stringstream ss;
-    ss << "data='";
-
-    unsigned char* waveData = (unsigned char*)wave.data;
-    char hexBuf[5];
-    for (unsigned int i = 0; i < wave.frameCount; i++) {
-        // Format \xNN
-        snprintf(hexBuf, sizeof(hexBuf), "\\x%02X", waveData[i]);
-        ss << hexBuf;
-    }
-    ss << "',\n(data.charCodeAt(t%data.length))";
-
-    UnloadWave(wave);
-    return ss.str();
+void StartWavImport(const char* filePath) {
+    state.importError.clear();
+    state.importer.Start(filePath, vector<int>(begin(state.rates), end(state.rates)));
 }
 
-string CompressCode(const string& code) {
-    state.hiddenChunks.clear();
-    state.hiddenCounter = 0;
-
-    stringstream out;
-    size_t len = code.length();
-
-    for (size_t i = 0; i < len; ++i) {
-        char c = code[i];
-
-        if (c == '\'' || c == '"') {
-            char quote = c;
-            size_t start = i;
-            i++;
-
-            while (i < len) {
-                if (code[i] == quote &&
-                    (i == 0 || code[i - 1] != '\\' ||
-                        (i >= 2 && code[i - 2] == '\\'))) 
-                    break;
-                i++;
-            }
-
-
-            size_t strLen = i - start + 1;
-            string content = code.substr(start, strLen);
-
-            if (strLen > 1000) {
-                // Generate unique key
-                string key = "@HIDDEN_DATA_" + to_string(state.hiddenCounter++) + "@";
-                state.hiddenChunks[key] = content;
-                out << key;
-            }
-            else out << content;
-
-        }
-        else out << c;
+void PollWavImport() {
+    WavImportResult result;
+    if (!state.importer.Collect(result)) return;
+    if (!result.ok) {
+        TraceLog(LOG_ERROR, "WAV: %s", result.error.c_str());
+        state.importError = result.error;
+        state.importErrorTimer = 3.0f;
+        return;
     }
-    return out.str();
-}
-
-string ExpandCode(const string& code) {
-    string result = code;
 
-    for (auto const& pair : state.hiddenChunks) {
-        string key = pair.first;
-        string value = pair.second;
-
-        size_t pos = 0;
-        while ((pos = result.find(key, pos)) != string::npos) {
-            result.replace(pos, key.length(), value);
-            pos += value.length();
-        }
+    // Keep the bytes as a sample asset, the formula only references it
+    int id = AddSample(move(result.samples));
+    LoadCodeToEditor("data=@sample(" + to_string(id) + "),\n(data.charCodeAt(t%data.length))");
+    for (int i = 0; i < 7; i++) {
+        if (state.rates[i] == result.sampleRate) state.rateIdx = i;
     }
-    return result;
 }
\ No newline at end of file
@@ -1,17 +1,27 @@
 ﻿#pragma once
 //#include "GlobalState.h"
+#include "imgui.h"
 #include <cstdint>
 #include <string>
 
 void ApplyTheme(int themeIdx);
 void UpdateErrorMarkers();
 void ExportToWav();
+void ExportToFlac();
 void LoadCodeToEditor(std::string fullCode);
 void LoadPresets(const std::string& folderPath);
 
-uint32_t FindTrigger(uint32_t currentT);
+// WAV files decode on a worker; poll once per frame to load the result into the editor
+void StartWavImport(const char* filePath);
+void PollWavImport();
 
-std::string FormatCode(const std::string& code, int maxChars);
-std::string ConvertWavToBytebeat(const char* filePath);
-std::string CompressCode(const std::string& fullCode);
-std::string ExpandCode(const std::string& shortCode);
\ No newline at end of file
+// Min/max of count samples split into columns slices. Each column also covers the last sample of
+// the previous one so neighbouring columns connect; with fewer samples than columns they repeat.
+void DecimateColumns(const uint8_t* samples, uint32_t count, int columns, uint8_t* lo, uint8_t* hi);
+
+// One quad per column spanning [lo, hi] (0 at the bottom, 255 at the top), written into a single
+// reserved vertex batch. color 0 draws a hue gradient across the width. Columns with lo > hi are skipped.
+void DrawColumnRanges(ImDrawList* dl, ImVec2 pos, ImVec2 size, const uint8_t* lo, const uint8_t* hi,
+    int columns, float thickness, ImU32 color);
+
+std::string FormatCode(const std::string& code, int maxChars);
\ No newline at end of file
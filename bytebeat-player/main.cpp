@@ -17,6 +17,8 @@
 #include "Bytebeat.h"
 #include "GlobalState.h"
 #include "AudioSystem.h"
+#include "Spectrogram.h"
+#include "TPlot.h"
 #include "Utils.h"
 
 // Binary data
@@ -51,6 +53,7 @@ int main() {
     AudioStream stream = LoadAudioStream(44100, 16, 1);
     SetAudioStreamCallback(stream, MyAudioCallback);
     PlayAudioStream(stream);
+    state.spectrum.Start(state.capture);
 
     // Init Presets
     LoadPresets("Presets");
@@ -77,9 +80,17 @@ int main() {
 
     // Init Compile
     state.valid = state.engine.Compile(state.inputBuf, state.errorMsg, state.errorPos);
+    if (state.valid) state.compiledCode = state.inputBuf;
     UpdateErrorMarkers();
     rlImGuiSetup(true);
 
+    Spectrogram spectrogram;
+    spectrogram.Load();
+    vector<vector<float>> spectrogramColumns;
+
+    TPlot tplot;
+    tplot.Load();
+
     ImGuiIO& io = ImGui::GetIO();
     io.Fonts->Clear();
     static const ImWchar ranges[] = { 0x0020, 0x00FF, 0x0100, 0x017F, 0 };
@@ -104,32 +115,39 @@ int main() {
             if (droppedFiles.count > 0) {
                 const char* filePath = droppedFiles.paths[0];
                 if (IsFileExtension(filePath, ".wav")) {
-                    string fullCode = ConvertWavToBytebeat(filePath);
-                    LoadCodeToEditor(fullCode);
+                    StartWavImport(filePath);
                 }
             }
             UnloadDroppedFiles(droppedFiles);
         }
+        PollWavImport();
 
         BeginDrawing();
         ClearBackground({ 15, 15, 20, 255 });
         rlImGuiBegin();
 
-        // LIVE COMPILATION
+        // LIVE COMPILATION (debounced on a worker, the previous program keeps playing meanwhile)
         if (state.editor.IsTextChanged()) {
-            string viewCode = state.editor.GetText(); // @HIDDEN
+            // Big literals stay @chunk(N) handles, the compiler resolves them from the chunk table
+            string viewCode = state.editor.GetText();
 
-            // Expand @HIDDEN -> \x80\x80...
-            string realCode = ExpandCode(viewCode);
-
-            // Copy to inputBuf viewCode bc realCode causes buffer overflow
             strncpy(state.inputBuf, viewCode.c_str(), sizeof(state.inputBuf) - 1);
             state.inputBuf[sizeof(state.inputBuf) - 1] = '\0';
 
-            state.errorMsg.clear();
-            state.errorMsg.clear();
-            state.valid = state.engine.Compile(realCode, state.errorMsg, state.errorPos);
-
+            if (state.valid && viewCode == state.compiledCode) state.compiler.Cancel();
+            else state.compiler.Request(viewCode);
+        }
+        CompileResult compiled;
+        if (state.compiler.Collect(compiled)) {
+            // Program and diagnostics change in the same frame
+            if (compiled.valid) {
+                state.engine.Swap(*compiled.engine, true);
+                state.compiledCode = compiled.code;
+            }
+            state.compiler.Recycle(move(compiled.engine));
+            state.valid = compiled.valid;
+            state.errorMsg = compiled.error;
+            state.errorPos = compiled.errorPos;
             UpdateErrorMarkers();
         }
 
@@ -152,10 +170,19 @@ int main() {
             ImGuiID dock_oscilloscope_id;
             ImGuiID dock_presets_id = ImGui::DockBuilderSplitNode(dock_right_id, ImGuiDir_Up, 0.5f, NULL, &dock_oscilloscope_id);
 
+            ImGuiID dock_overview_id;
+            dock_oscilloscope_id = ImGui::DockBuilderSplitNode(dock_oscilloscope_id, ImGuiDir_Up, 0.75f, NULL, &dock_overview_id);
+
+            ImGuiID dock_spectrum_id;
+            dock_oscilloscope_id = ImGui::DockBuilderSplitNode(dock_oscilloscope_id, ImGuiDir_Left, 0.6f, NULL, &dock_spectrum_id);
+
             ImGui::DockBuilderDockWindow("Editor", dock_editor_id);
             ImGui::DockBuilderDockWindow("Settings", dock_settings_id);
             ImGui::DockBuilderDockWindow("Presets", dock_presets_id);
             ImGui::DockBuilderDockWindow("Oscilloscope", dock_oscilloscope_id);
+            ImGui::DockBuilderDockWindow("Spectrum", dock_spectrum_id);
+            ImGui::DockBuilderDockWindow("T-Plot", dock_spectrum_id);
+            ImGui::DockBuilderDockWindow("Overview", dock_overview_id);
 
             ImGui::DockBuilderFinish(dockspace_id);
         }
@@ -225,6 +252,17 @@ int main() {
         ImGui::SliderFloat("Volume", &state.volume, 0.0f, 1.0f, "%.2f");
         ImGui::Combo("Sample Rate", &state.rateIdx, state.rateNames, 7);
 
+        ImGui::Spacing();
+        ImGui::Separator();
+        ImGui::Spacing();
+
+        ImGui::Text("Oscilloscope");
+        const char* triggerNames[] = { "Off", "Rising", "Falling", "Auto" };
+        ImGui::Combo("Trigger", &state.trigger.mode, triggerNames, 4);
+        ImGui::SliderInt("Level", &state.trigger.level, 0, 255);
+        ImGui::SliderInt("Holdoff", &state.trigger.holdoff, 0, 8192, "%d samples");
+        ImGui::SliderInt("Overview", &state.overviewMinutes, 1, 240, "%d min");
+
         ImGui::Spacing(); 
         ImGui::Separator(); 
         ImGui::Spacing();
@@ -239,10 +277,10 @@ int main() {
         ImGui::NextColumn();
         float buttonWidth = ImGui::GetContentRegionAvail().x;
 
-        if (ImGui::Button("Copy Formula", ImVec2(buttonWidth, 0))) ImGui::SetClipboardText(state.editor.GetText().c_str());
+        if (ImGui::Button("Copy Formula", ImVec2(buttonWidth, 0))) ImGui::SetClipboardText(ExpandCode(state.editor.GetText()).c_str());
         if (!state.valid) ImGui::BeginDisabled();
-        if (ImGui::Button("Export to WAV", ImVec2(buttonWidth, 0))) {
-            strncpy(state.exportFilenameBuf, "output.wav", sizeof(state.exportFilenameBuf) - 1);
+        if (ImGui::Button("Export Audio", ImVec2(buttonWidth, 0))) {
+            strncpy(state.exportFilenameBuf, state.exportFormat == 1 ? "output.flac" : "output.wav", sizeof(state.exportFilenameBuf) - 1);
             ImGui::OpenPopup("ExportBytebeat");
         }
         
@@ -256,6 +294,9 @@ int main() {
             ImGui::InputText("Filename", state.exportFilenameBuf, sizeof(state.exportFilenameBuf));
             ImGui::InputInt("Duration (s)", &state.exportDuration);
 
+            const char* formatNames[] = { "WAV (8-bit PCM)", "FLAC (lossless)" };
+            ImGui::Combo("Format", &state.exportFormat, formatNames, 2);
+
             if (state.exportDuration < 1) state.exportDuration = 1;
 
             ImGui::Spacing();
@@ -263,7 +304,8 @@ int main() {
             ImGui::Spacing();
 
             if (ImGui::Button("Export", ImVec2(120, 0))) {
-                ExportToWav();
+                if (state.exportFormat == 1) ExportToFlac();
+                else ExportToWav();
                 ImGui::CloseCurrentPopup();
             }
             ImGui::SetItemDefaultFocus();
@@ -276,7 +318,7 @@ int main() {
         if (!state.valid) ImGui::EndDisabled();
 
         ImGui::Columns(1);
-        ImGui::TextDisabled("Saves audio as .wav in project folder");
+        ImGui::TextDisabled("Saves audio as .wav or .flac in Exports folder");
         ImGui::End();
 
         // --- PRESETS WINDOW ---
@@ -336,23 +378,27 @@ int main() {
             dl->AddRectFilled(p, { p.x + sz.x, p.y + sz.y }, IM_COL32(10, 10, 15, 255));
             dl->AddLine({ p.x, p.y + sz.y / 2 }, { p.x + sz.x, p.y + sz.y / 2 }, IM_COL32(100, 100, 120, 255), 1.0f);
 
-            uint32_t triggeredT = FindTrigger(state.t);
+            // Read played audio from the capture ring: never evaluate the engine on the UI thread
             float numSamples = 512.0f * state.zoomFactors[state.zoomIdx];
-
-            for (int n = 0; n < 255; n++) {
-                float tIdx1 = ((float)n / 256.0f) * numSamples;
-                float tIdx2 = ((float)(n + 1) / 256.0f) * numSamples;
-
-                // Optimized call
-                int v1 = state.engine.Eval(triggeredT + (uint32_t)tIdx1);
-                int v2 = state.engine.Eval(triggeredT + (uint32_t)tIdx2);
-
-                float x1 = p.x + (float)n / 256.0f * sz.x;
-                float y1 = p.y + sz.y - (((v1 & 0xFF) / 255.0f) * sz.y);
-                float x2 = p.x + (float)(n + 1) / 256.0f * sz.x;
-                float y2 = p.y + sz.y - (((v2 & 0xFF) / 255.0f) * sz.y);
-
-                dl->AddLine({ x1, y1 }, { x2, y2 }, ImColor::HSV(n / 256.0f, 0.8f, 1.0f), 2.5f);
+            uint32_t window = (uint32_t)numSamples + 1;
+            static vector<uint8_t> history;
+            history.resize(window);
+
+            uint64_t start = 0;
+            if (!state.trigger.Update(state.capture, window, start) ||
+                !state.capture.Read(start + window, window, history.data())) {
+                const char* hint = "Press PLAY to capture audio";
+                ImVec2 hintSize = ImGui::CalcTextSize(hint);
+                dl->AddText({ p.x + (sz.x - hintSize.x) / 2, p.y + sz.y / 2 - hintSize.y - 40.0f }, IM_COL32(120, 120, 140, 255), hint);
+            }
+            else {
+                // One min/max column per pixel: resolution follows the window, peaks survive zooming out
+                int columns = max(1, (int)sz.x);
+                static vector<uint8_t> scopeLo, scopeHi;
+                scopeLo.resize(columns);
+                scopeHi.resize(columns);
+                DecimateColumns(history.data(), (uint32_t)numSamples, columns, scopeLo.data(), scopeHi.data());
+                DrawColumnRanges(dl, p, sz, scopeLo.data(), scopeHi.data(), columns, 2.5f, 0);
             }
         }
 
@@ -384,6 +430,179 @@ int main() {
         }
         ImGui::End();
 
+        // --- SPECTRUM WINDOW ---
+        ImGui::Begin("Spectrum");
+        {
+            const char* sizeNames[] = { "512", "1024", "2048", "4096", "8192", "16384" };
+            const char* overlapNames[] = { "0%", "50%", "75%", "87.5%", "93.75%" };
+            int sizeIdx = state.spectrum.sizeLog2 - SpectrumAnalyzer::MIN_SIZE_LOG2;
+            int overlapIdx = state.spectrum.overlapLog2;
+
+            ImGui::SetNextItemWidth(ImGui::GetContentRegionAvail().x * 0.45f);
+            if (ImGui::Combo("##FftSize", &sizeIdx, sizeNames, 6)) state.spectrum.sizeLog2 = sizeIdx + SpectrumAnalyzer::MIN_SIZE_LOG2;
+            if (ImGui::IsItemHovered()) ImGui::SetTooltip("FFT size");
+            ImGui::SameLine();
+            ImGui::SetNextItemWidth(-1);
+            if (ImGui::Combo("##FftOverlap", &overlapIdx, overlapNames, 5)) state.spectrum.overlapLog2 = overlapIdx;
+            if (ImGui::IsItemHovered()) ImGui::SetTooltip("Window overlap");
+
+            static vector<float> spectrum;
+            static uint64_t spectrumSerial = 0;
+            state.spectrum.Latest(spectrum, spectrumSerial);
+
+            // One texture column per hop, drained every frame even if the window is hidden
+            state.spectrum.DrainColumns(spectrogramColumns);
+            for (const auto& column : spectrogramColumns) spectrogram.Push(column, (float)state.rates[state.rateIdx]);
+
+            // Spectrum on top, spectrogram below
+            ImVec2 sp = ImGui::GetCursorScreenPos();
+            ImVec2 area = ImGui::GetContentRegionAvail();
+            ImVec2 ssz(area.x, area.y * 0.45f);
+            ImDrawList* sdl = ImGui::GetWindowDrawList();
+            spectrogram.Draw(sdl, { sp.x, sp.y + ssz.y + 4.0f }, { area.x, area.y - ssz.y - 4.0f });
+            sdl->AddRectFilled(sp, { sp.x + ssz.x, sp.y + ssz.y }, IM_COL32(10, 10, 15, 255));
+
+            // 0 dB at the top, -96 dB at the bottom
+            const float dbRange = 96.0f;
+            for (int db = 24; db < (int)dbRange; db += 24) {
+                float y = sp.y + ssz.y * db / dbRange;
+                sdl->AddLine({ sp.x, y }, { sp.x + ssz.x, y }, IM_COL32(40, 40, 55, 255), 1.0f);
+            }
+
+            if (spectrum.size() > 2 && ssz.x > 4.0f) {
+                // Log frequency axis from the first bin to Nyquist
+                float rate = (float)state.rates[state.rateIdx];
+                int bins = (int)spectrum.size() - 1;
+                float fMax = rate * 0.5f;
+                float fMin = max(20.0f, fMax / bins);
+                float logSpan = logf(fMax / fMin);
+
+                for (float f : { 100.0f, 1000.0f, 10000.0f }) {
+                    if (f <= fMin || f >= fMax) continue;
+                    float x = sp.x + ssz.x * logf(f / fMin) / logSpan;
+                    sdl->AddLine({ x, sp.y }, { x, sp.y + ssz.y }, IM_COL32(40, 40, 55, 255), 1.0f);
+                    sdl->AddText({ x + 3, sp.y + ssz.y - ImGui::GetFontSize() - 2 }, IM_COL32(100, 100, 120, 255), f >= 1000.0f ? (f >= 10000.0f ? "10k" : "1k") : "100");
+                }
+
+                static vector<ImVec2> points;
+                points.clear();
+                const float step = 2.0f;
+                for (float x = 0.0f; x < ssz.x; x += step) {
+                    float f0 = fMin * expf(logSpan * x / ssz.x);
+                    float f1 = fMin * expf(logSpan * min(x + step, ssz.x) / ssz.x);
+                    int b0 = clamp((int)(f0 / fMax * bins), 1, bins);
+                    int b1 = clamp((int)(f1 / fMax * bins), b0, bins);
+
+                    float db = -dbRange;
+                    for (int b = b0; b <= b1; b++) db = max(db, spectrum[b]);
+                    float y = sp.y + ssz.y * min(1.0f, -db / dbRange);
+                    points.push_back({ sp.x + x, max(sp.y, y) });
+                }
+                sdl->AddPolyline(points.data(), (int)points.size(), IM_COL32(60, 180, 255, 255), 0, 2.0f);
+            }
+        }
+        ImGui::End();
+
+        // --- T-PLOT WINDOW ---
+        if (ImGui::Begin("T-Plot")) {
+            // Only updated while visible; live mode catches up from the capture ring when shown again
+            static int tplotMode = 0; // 0 = live, 1 = offline
+            ImGui::RadioButton("Live", &tplotMode, 0);
+            ImGui::SameLine();
+            ImGui::RadioButton("Offline", &tplotMode, 1);
+            if (ImGui::IsItemHovered()) ImGui::SetTooltip("Render t = 0 .. %d in the background", TPlot::COLUMNS * TPlot::ROWS);
+
+            if (tplotMode == 0) tplot.UpdateLive(state.capture);
+            else {
+                if (state.valid && tplot.OfflineCode() != state.compiledCode) tplot.StartOffline(state.compiledCode);
+                tplot.UpdateOffline();
+                if (tplot.OfflineProgress() < 1.0f) {
+                    ImGui::SameLine();
+                    ImGui::Text("%d%%", (int)(tplot.OfflineProgress() * 100.0f));
+                }
+            }
+
+            ImVec2 tp = ImGui::GetCursorScreenPos();
+            ImVec2 tsz = ImGui::GetContentRegionAvail();
+            tplot.Draw(ImGui::GetWindowDrawList(), tp, tsz, tplotMode == 0);
+        }
+        ImGui::End();
+
+        // --- OVERVIEW WINDOW ---
+        ImGui::Begin("Overview");
+        {
+            // Re-render in the background whenever the program or rate changes
+            int rate = state.rates[state.rateIdx];
+            uint64_t length = (uint64_t)rate * 60 * state.overviewMinutes;
+            if (state.valid && (state.overview.Code() != state.compiledCode || state.overview.Rate() != rate || state.overview.Length() != length)) {
+                state.overview.Start(state.compiledCode, rate, length);
+            }
+
+            static double viewStart = 0.0;
+            static double viewSpan = 0.0;
+            if (viewSpan <= 0.0 || viewSpan > (double)length) {
+                viewStart = 0.0;
+                viewSpan = (double)length;
+            }
+
+            ImVec2 op = ImGui::GetCursorScreenPos();
+            ImVec2 osz = ImGui::GetContentRegionAvail();
+            osz.y = max(osz.y, 20.0f);
+            ImDrawList* odl = ImGui::GetWindowDrawList();
+            odl->AddRectFilled(op, { op.x + osz.x, op.y + osz.y }, IM_COL32(10, 10, 15, 255));
+
+            ImGui::InvisibleButton("##OverviewStrip", { max(osz.x, 1.0f), osz.y });
+            static bool overviewDragged = false;
+            if (ImGui::IsItemActivated()) overviewDragged = false;
+
+            if (ImGui::IsItemHovered()) {
+                // Wheel zooms around the cursor, from a few samples up to the whole length
+                float wheel = ImGui::GetIO().MouseWheel;
+                if (wheel != 0.0f) {
+                    double anchor = viewStart + viewSpan * (ImGui::GetMousePos().x - op.x) / osz.x;
+                    double span = clamp(viewSpan * pow(0.8, (double)wheel), 16.0, (double)length);
+                    viewStart = anchor - (anchor - viewStart) * span / viewSpan;
+                    viewSpan = span;
+                }
+                ImGui::SetTooltip("LMB: Seek\nDrag: Pan\nWheel: Zoom");
+            }
+            if (ImGui::IsItemActive() && ImGui::IsMouseDragging(ImGuiMouseButton_Left)) {
+                overviewDragged = true;
+                viewStart -= viewSpan * ImGui::GetIO().MouseDelta.x / osz.x;
+            }
+            if (ImGui::IsItemDeactivated() && !overviewDragged) {
+                double seek = viewStart + viewSpan * (ImGui::GetMousePos().x - op.x) / osz.x;
+                state.t = (uint32_t)clamp(seek, 0.0, (double)length - 1.0);
+                state.tAccum = 0.0;
+            }
+            viewStart = clamp(viewStart, 0.0, (double)length - viewSpan);
+
+            int columns = (int)osz.x;
+            static vector<uint8_t> colMin, colMax;
+            if (columns > 0) {
+                colMin.resize(columns);
+                colMax.resize(columns);
+                state.overview.Query(viewStart, viewStart + viewSpan, columns, colMin.data(), colMax.data());
+                DrawColumnRanges(odl, op, osz, colMin.data(), colMax.data(), columns, 1.0f, IM_COL32(60, 180, 255, 200));
+            }
+
+            // Not rendered yet
+            double rendered = (double)state.overview.Rendered();
+            if (rendered < viewStart + viewSpan) {
+                float x = op.x + (float)max(0.0, (rendered - viewStart) / viewSpan) * osz.x;
+                odl->AddRectFilled({ x, op.y }, { op.x + osz.x, op.y + osz.y }, IM_COL32(40, 40, 55, 120));
+            }
+
+            // Playhead and visible range
+            float playX = op.x + (float)(((double)state.t - viewStart) / viewSpan) * osz.x;
+            if (playX >= op.x && playX <= op.x + osz.x) odl->AddLine({ playX, op.y }, { playX, op.y + osz.y }, IM_COL32(255, 255, 255, 220), 1.5f);
+
+            char rangeBuf[64];
+            snprintf(rangeBuf, sizeof(rangeBuf), "%.2f s - %.2f s", viewStart / rate, (viewStart + viewSpan) / rate);
+            odl->AddText({ op.x + 4, op.y + 2 }, IM_COL32(150, 150, 170, 255), rangeBuf);
+        }
+        ImGui::End();
+
         // --- SUCCESS POPUP ---
         if (state.successMsgTimer > 0) {
             float dt = GetFrameTime();
@@ -410,11 +629,38 @@ int main() {
             ImGui::PopStyleVar(); 
         }
 
+        // --- IMPORT STATUS ---
+        if (state.importer.Busy() || state.importErrorTimer > 0) {
+            ImGui::SetNextWindowPos(ImVec2(GetScreenWidth() / 2.0f, GetScreenHeight() / 2.0f), ImGuiCond_Always, ImVec2(0.5f, 0.5f));
+            ImGuiWindowFlags flags = ImGuiWindowFlags_NoTitleBar | ImGuiWindowFlags_AlwaysAutoResize | ImGuiWindowFlags_NoInputs | ImGuiWindowFlags_NoDecoration | ImGuiWindowFlags_NoMove;
+
+            if (ImGui::Begin("##Import", NULL, flags)) {
+                if (state.importer.Busy()) {
+                    ImGui::Text("Importing '%s'", GetFileName(state.importer.Path().c_str()));
+                    ImGui::ProgressBar(state.importer.Progress(), ImVec2(300, 0));
+                }
+                else {
+                    ImGui::TextColored(ImVec4(1.0f, 0.4f, 0.4f, 1.0f), "IMPORT FAILED: %s", state.importError.c_str());
+                    state.importErrorTimer -= GetFrameTime();
+                }
+            }
+            ImGui::End();
+        }
+
         rlImGuiEnd();
         DrawFPS(GetScreenWidth() - 85, 5);
+        ProgramCache& cache = state.compiler.Cache();
+        const char* cacheText = TextFormat("Programs: %llu hit / %llu miss", (unsigned long long)cache.Hits(), (unsigned long long)cache.Misses());
+        DrawText(cacheText, GetScreenWidth() - MeasureText(cacheText, 10) - 5, 27, 10, LIME);
         EndDrawing();
     }
 
+    state.spectrum.Stop();
+    state.overview.Stop();
+    state.importer.Cancel();
+    state.compiler.Stop();
+    spectrogram.Unload();
+    tplot.Unload();
     rlImGuiShutdown();
     UnloadAudioStream(stream);
     CloseAudioDevice();